@@ -1,5 +1,6 @@
 ﻿#include "Album.h"
 #include "ItemNotFoundException.h"
+#include <ctime>
 #include <iomanip>
 #include <sstream>
 
@@ -10,13 +11,23 @@ Album::Album(int ownerId, const std::string& name) :
 	setCreationDateNow();
 }
 
-Album::Album(int ownerId, const std::string & name, const std::string & creationTime) :
-	m_ownerId(ownerId), m_name(name), m_creationDate(creationTime), m_pictures{}
+Album::Album(int ownerId, const std::string & name, long long creationTime) :
+	m_ownerId(ownerId), m_name(name), m_creationTime(creationTime), m_pictures{}
 {
 	// Left empty
 }
 
 
+int Album::getId() const
+{
+	return m_id;
+}
+
+void Album::setId(int id)
+{
+	m_id = id;
+}
+
 const std::string& Album::getName() const
 {
 	return m_name;
@@ -37,22 +48,27 @@ void Album::setOwner(int userId)
 	m_ownerId = userId;
 }
 
-std::string Album::getCreationDate() const
+long long Album::getCreationTime() const
 {
-	return m_creationDate;
+	return m_creationTime;
 }
 
-void Album::setCreationDate(const std::string& creationTime)
+void Album::setCreationTime(long long creationTime)
 {
-	m_creationDate = creationTime;
+	m_creationTime = creationTime;
 }
 
-void Album::setCreationDateNow()
+std::string Album::getCreationDate() const
 {
-	time_t now = time(nullptr);
+	time_t creationTime = (time_t)m_creationTime;
 	std::stringstream oss;
-	oss << std::put_time(localtime(&now), "%d/%m/%Y %H:%M:%S");
-	m_creationDate = oss.str();
+	oss << std::put_time(localtime(&creationTime), "%d/%m/%Y %H:%M:%S");
+	return oss.str();
+}
+
+void Album::setCreationDateNow()
+{
+	m_creationTime = time(nullptr);
 }
 
 
@@ -66,12 +82,27 @@ Picture Album::getPicture(const std::string& pictureName) const
 	throw ItemNotFoundException("Picture", pictureName);
 }
 
+Picture Album::getPicture(int pictureId) const
+{
+	for (auto& picture: m_pictures) {
+		if (pictureId == picture.getId()) {
+			return picture;
+		}
+	}
+	throw ItemNotFoundException("Picture", pictureId);
+}
+
 
 std::list<Picture> Album::getPictures() const
 {
 	return m_pictures;
 }
 
+size_t Album::getPicturesCount() const
+{
+	return m_pictures.size();
+}
+
 void Album::untagUserInAlbum(int userId)
 {
 	for(auto& picture: m_pictures) {
@@ -86,6 +117,16 @@ void Album::tagUserInAlbum(int userId)
 	}
 }
 
+bool Album::isUserTaggedInAlbum(int userId) const
+{
+	for (const auto& picture : m_pictures) {
+		if (picture.isUserTagged(userId)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 void Album::untagUserInPicture(int userId, const std::string & pictureName)
 {
 	for (auto& picture : m_pictures) {
@@ -134,6 +175,16 @@ bool Album::doesPictureExists(const std::string& name) const
 	return false;
 }
 
+bool Album::doesPictureExists(int pictureId) const
+{
+	for (const auto& picture : m_pictures) {
+		if (pictureId == picture.getId()) {
+			return true;
+		}
+	}
+	return false;
+}
+
 bool Album::operator==(const Album& other) const
 {
 	return m_ownerId == other.getOwnerId();
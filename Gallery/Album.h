@@ -9,7 +9,10 @@ class Album
 public:
     Album() = default;
 	Album(int ownerId, const std::string& name);
-	Album(int ownerId, const std::string& name, const std::string& creationTime);
+	Album(int ownerId, const std::string& name, long long creationTime);
+
+	int getId() const;
+	void setId(int id);
 
 	const std::string& getName() const;
 	void setName(const std::string& name);
@@ -17,19 +20,24 @@ public:
 	int getOwnerId() const;
 	void setOwner(int userId);
 
-	std::string getCreationDate() const;
-	void setCreationDate(const std::string& creationTime);
+	long long getCreationTime() const;
+	void setCreationTime(long long creationTime);
+	std::string getCreationDate() const; // the creation time formatted for display, in local time
 	void setCreationDateNow();
 
 	bool doesPictureExists(const std::string& name) const;
+	bool doesPictureExists(int pictureId) const;
 	void addPicture(const Picture& picture);
 	void removePicture(const std::string& pictureName);
 
 	Picture getPicture(const std::string& name) const;
+	Picture getPicture(int pictureId) const;
 	std::list<Picture> getPictures() const;
+	size_t getPicturesCount() const;
 
 	void untagUserInAlbum(int userId);
 	void tagUserInAlbum(int userId);
+	bool isUserTaggedInAlbum(int userId) const; // in any of its pictures
 
 	void untagUserInPicture(int userId, const std::string& pictureName);
 	void tagUserInPicture(int userId, const std::string& pictureName);
@@ -38,8 +46,9 @@ public:
 	friend std::ostream& operator<<(std::ostream& strOut, const Album& album);
 
 private:
+    int m_id { 0 };
     int m_ownerId { 0 };
 	std::string m_name;
-	std::string m_creationDate;
+	long long m_creationTime { 0 }; // seconds since the epoch
 	std::list<Picture> m_pictures;
 };
@@ -5,11 +5,15 @@
 #include "AlbumNotOpenException.h"
 
 #include <algorithm>
+#include <ctime>
+#include <fstream>
+#include <optional>
+#include <sstream>
 
 PROCESS_INFORMATION AlbumManager::showPicPI = { 0 };
 
  AlbumManager::AlbumManager(IDataAccess& dataAccess):
-    m_dataAccess(dataAccess), m_nextPictureId(100), m_nextUserId(200)
+    m_dataAccess(dataAccess), m_nextUserId(200)
 {
 	m_dataAccess.open();
 }
@@ -72,12 +76,15 @@ void AlbumManager::openAlbum()
 	}
 
 	std::string name = getInputFromConsole("Enter album name - ");
-	if ( !m_dataAccess.doesAlbumExists(name, userId) ) {
+	long long version = m_dataAccess.getDataVersion();
+	std::optional<Album> album = m_dataAccess.findAlbum(name, userId);
+	if ( !album ) {
 		throw MyException("Error: Failed to open album, since there is no album with name:"+name +".\n");
 	}
 
-	m_openAlbum = m_dataAccess.openAlbum(name);
-    m_currentAlbumName = name;
+	m_openAlbumVersion = version;
+	m_openAlbum = *album;
+    m_currentAlbumId = album->getId();
 	// success
 	std::cout << "Album [" << name << "] opened successfully." << std::endl;
 }
@@ -88,7 +95,7 @@ void AlbumManager::closeAlbum()
 
 	std::cout << "Album [" << m_openAlbum.getName() << "] closed successfully." << std::endl;
 	m_dataAccess.closeAlbum(m_openAlbum);
-	m_currentAlbumName = "";
+	m_currentAlbumId = -1;
 }
 
 void AlbumManager::deleteAlbum()
@@ -116,25 +123,26 @@ void AlbumManager::deleteAlbum()
 
 void AlbumManager::listAlbums()
 {
-	m_dataAccess.printAlbums();
+	std::cout << "Album list:" << std::endl;
+	std::cout << "-----------" << std::endl;
+	printPaged<Album>([this](int afterId) { return m_dataAccess.getAlbums(afterId, LIST_PAGE_SIZE); },
+		[](const Album& album) { std::cout << std::setw(5) << "* " << album; });
 }
 
 void AlbumManager::listAlbumsOfUser()
 {
 	int userId = getIntInputFromConsole("Enter user id: ");
-	if (!m_dataAccess.doesUserExists(userId)) {
+	std::optional<User> user = m_dataAccess.findUser(userId);
+	if (!user) {
 		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
 	}
 
-	User user = m_dataAccess.getUser(userId);
-	std::list<Album> albums = m_dataAccess.getAlbumsOfUser(user);
-
-	std::cout << "Albums list of user@" << user.getId() << ":" << std::endl;
+	std::cout << "Albums list of user@" << user->getId() << ":" << std::endl;
 	std::cout << "-----------------------" << std::endl;
 
-	for (const auto& album : albums) {
+	m_dataAccess.forEachAlbumOfUser(*user, [](const Album& album) {
 		std::cout <<"   + [" << album.getName() <<"] - created on "<< album.getCreationDate() << std::endl;
-	}
+	});
 }
 
 
@@ -148,11 +156,11 @@ void AlbumManager::addPictureToAlbum()
 		throw MyException("Error: Failed to add picture, picture with the same name already exists.\n");
 	}
 	
-	Picture picture(++m_nextPictureId, picName);
+	Picture picture(0, picName); // the id is given by the data access
 	std::string picPath = getInputFromConsole("Enter picture path: ");
 	picture.setPath(picPath);
 
-	m_dataAccess.addPictureToAlbumByName(m_openAlbum.getName(), picture);
+	m_dataAccess.addPictureToAlbum(m_openAlbum.getId(), picture);
 
 	std::cout << "Picture [" << picture.getId() << "] successfully added to Album [" << m_openAlbum.getName() << "]." << std::endl;
 }
@@ -167,22 +175,39 @@ void AlbumManager::removePictureFromAlbum()
 	}
 	
 	auto picture = m_openAlbum.getPicture(picName);
-	m_dataAccess.removePictureFromAlbumByName(m_openAlbum.getName(), picture.getName());
+	m_dataAccess.removePicture(picture.getId());
 	std::cout << "Picture <" << picName << "> successfully removed from Album [" << m_openAlbum.getName() << "]." << std::endl;
 }
 
 void AlbumManager::listPicturesInAlbum()
 {
-	refreshOpenAlbum();
+	if (!isCurrentAlbumSet()) {
+		throw AlbumNotOpenException();
+	}
 
 	std::cout << "List of pictures in Album [" << m_openAlbum.getName() 
 			  << "] of user@" << m_openAlbum.getOwnerId() <<":" << std::endl;
 	
-	const std::list<Picture>& albumPictures = m_openAlbum.getPictures();
-	for (auto iter = albumPictures.begin(); iter != albumPictures.end(); ++iter) {
-		std::cout << "   + Picture [" << iter->getId() << "] - " << iter->getName() << 
-			"\tLocation: [" << iter->getPath() << "]\tCreation Date: [" <<
-				iter->getCreationDate() << "]\tTags: [" << iter->getTagsCount() << "]" << std::endl;
+	// paged straight from the data access instead of reloading the whole album
+	printPaged<Picture>([this](int afterId) { return m_dataAccess.getPicturesOfAlbum(m_currentAlbumId, afterId, LIST_PAGE_SIZE); },
+		[](const Picture& picture) {
+			std::cout << "   + Picture [" << picture.getId() << "] - " << picture.getName() << 
+				"\tLocation: [" << picture.getPath() << "]\tCreation Date: [" <<
+					picture.getCreationDate() << "]\tTags: [" << picture.getTagsCount() << "]" << std::endl;
+		});
+	std::cout << std::endl;
+}
+
+void AlbumManager::listPicturesCreatedBetween()
+{
+	refreshOpenAlbum();
+
+	long long from = getDateInputFromConsole("Enter the first date (dd/mm/yyyy): ", false);
+	long long to = getDateInputFromConsole("Enter the last date (dd/mm/yyyy): ", true);
+
+	std::cout << "Pictures in Album [" << m_openAlbum.getName() << "] created between the dates:" << std::endl;
+	for (const auto& picture : m_dataAccess.getPicturesOfAlbumCreatedBetween(m_openAlbum.getId(), from, to)) {
+		std::cout << "   + " << picture << std::endl;
 	}
 	std::cout << std::endl;
 }
@@ -309,9 +334,9 @@ void AlbumManager::copyPicture()
 
 	// add the copied picture to the album
 	// use this constructor because it sets the creation date automatically
-	Picture copiedPic(++m_nextPictureId, "CopyOf_" + picName); 
+	Picture copiedPic(0, "CopyOf_" + picName); 
 	copiedPic.setPath(copiedFilePath);
-	m_dataAccess.addPictureToAlbumByName(m_openAlbum.getName(), copiedPic);
+	m_dataAccess.addPictureToAlbum(m_openAlbum.getId(), copiedPic);
 	m_openAlbum.addPicture(copiedPic);
 	std::cout << "Successfuly copied picture in album." << std::endl 
 		<< "\tName - <" << copiedPic.getName() << '>' << std::endl 
@@ -333,9 +358,8 @@ void AlbumManager::tagUserInPicture()
 	if ( !m_dataAccess.doesUserExists(userId) ) {
 		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
 	}
-	User user = m_dataAccess.getUser(userId);
 
-	m_dataAccess.tagUserInPicture(m_openAlbum.getName(), pic.getName(), user.getId());
+	m_dataAccess.tagUser(pic.getId(), userId);
 	std::cout << "User @" << std::to_string(userId) << " successfully tagged in picture <" << pic.getName() << "> in album [" << m_openAlbum.getName() << "]" << std::endl;
 }
 
@@ -354,17 +378,42 @@ void AlbumManager::untagUserInPicture()
 	if (!m_dataAccess.doesUserExists(userId)) {
 		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
 	}
-	User user = m_dataAccess.getUser(userId);
 
-	if (! pic.isUserTagged(user)) {
+	if (! pic.isUserTagged(userId)) {
 		throw MyException("Error: The user was not tagged! \n");
 	}
 
-	m_dataAccess.untagUserInPicture(m_openAlbum.getName(), pic.getName(), user.getId());
+	m_dataAccess.untagUser(pic.getId(), userId);
 	std::cout << "User @" << std::to_string(userId) << " successfully untagged in picture <" << pic.getName() << "> in album [" << m_openAlbum.getName() << "]" << std::endl;
 
 }
 
+void AlbumManager::tagUserInAlbum()
+{
+	refreshOpenAlbum();
+
+	int userId = getIntInputFromConsole("Enter user id to tag: ");
+	if ( !m_dataAccess.doesUserExists(userId) ) {
+		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
+	}
+
+	m_dataAccess.tagUserInAlbum(m_openAlbum.getId(), userId);
+	std::cout << "User @" << std::to_string(userId) << " successfully tagged in all pictures in album [" << m_openAlbum.getName() << "]" << std::endl;
+}
+
+void AlbumManager::untagUserInAlbum()
+{
+	refreshOpenAlbum();
+
+	int userId = getIntInputFromConsole("Enter user id: ");
+	if (!m_dataAccess.doesUserExists(userId)) {
+		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
+	}
+
+	m_dataAccess.untagUserInAlbum(m_openAlbum.getId(), userId);
+	std::cout << "User @" << std::to_string(userId) << " successfully untagged in all pictures in album [" << m_openAlbum.getName() << "]" << std::endl;
+}
+
 void AlbumManager::listUserTags()
 {
 	refreshOpenAlbum();
@@ -407,37 +456,41 @@ void AlbumManager::removeUser()
 {
 	// get user name
 	int userId = getIntInputFromConsole("Enter user id: ");
-	if ( !m_dataAccess.doesUserExists(userId) ) {
+	std::optional<User> user = m_dataAccess.findUser(userId);
+	if ( !user ) {
 		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
 	}
-	User user = m_dataAccess.getUser(userId);
 	if (isCurrentAlbumSet() && userId == m_openAlbum.getOwnerId()) {
 		closeAlbum();
 	}
 
-	m_dataAccess.deleteUser(user);
+	m_dataAccess.deleteUser(*user);
 	std::cout << "User @" << userId << " deleted successfully." << std::endl;
 }
 
 void AlbumManager::listUsers()
 {
-	m_dataAccess.printUsers();	
+	std::cout << "Users list:" << std::endl;
+	std::cout << "-----------" << std::endl;
+	printPaged<User>([this](int afterId) { return m_dataAccess.getUsers(afterId, LIST_PAGE_SIZE); },
+		[](const User& user) { std::cout << user << std::endl; });
 }
 
 void AlbumManager::userStatistics()
 {
 	int userId = getIntInputFromConsole("Enter user id: ");
-	if ( !m_dataAccess.doesUserExists(userId) ) {
+	std::optional<User> user = m_dataAccess.findUser(userId);
+	if ( !user ) {
 		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
 	}
 
-	User user = m_dataAccess.getUser(userId);
+	UserStatistics stats = m_dataAccess.getUserStatistics(*user);
 
 	std::cout << "user @" << userId << " Statistics:" << std::endl << "--------------------" << std::endl <<
-		"  + Count of Albums Tagged: " << m_dataAccess.countAlbumsTaggedOfUser(user) << std::endl <<
-		"  + Count of Tags: " << m_dataAccess.countTagsOfUser(user) << std::endl <<
-		"  + Avarage Tags per Alboum: " << m_dataAccess.averageTagsPerAlbumOfUser(user) << std::endl <<
-		"  + Count of Albums Owned: " << m_dataAccess.countAlbumsOwnedOfUser(user) << std::endl;
+		"  + Count of Albums Tagged: " << stats.albumsTagged << std::endl <<
+		"  + Count of Tags: " << stats.tags << std::endl <<
+		"  + Avarage Tags per Alboum: " << stats.averageTagsPerAlbum << std::endl <<
+		"  + Count of Albums Owned: " << stats.albumsOwned << std::endl;
 }
 
 
@@ -455,25 +508,119 @@ void AlbumManager::topTaggedPicture()
 void AlbumManager::picturesTaggedUser()
 {
 	int userId = getIntInputFromConsole("Enter user id: ");
-	if ( !m_dataAccess.doesUserExists(userId) ) {
+	std::optional<User> user = m_dataAccess.findUser(userId);
+	if ( !user ) {
 		throw MyException("Error: There is no user with id @" + std::to_string(userId) + "\n");
 	}
 
-	auto user = m_dataAccess.getUser(userId);
+	std::cout << "List of pictures that User@" << user->getId() << " tagged :" << std::endl;
+	m_dataAccess.forEachTaggedPictureOfUser(*user, [](const Picture& picture) {
+		std::cout << "   + " << picture << std::endl;
+	});
+	std::cout << std::endl;
+}
+
+void AlbumManager::picturesCreatedBetween()
+{
+	long long from = getDateInputFromConsole("Enter the first date (dd/mm/yyyy): ", false);
+	long long to = getDateInputFromConsole("Enter the last date (dd/mm/yyyy): ", true);
+
+	std::cout << "Pictures created between the dates:" << std::endl;
+	for (const auto& picture : m_dataAccess.getPicturesCreatedBetween(from, to)) {
+		std::cout << "   + " << picture << std::endl;
+	}
+	std::cout << std::endl;
+}
+
+void AlbumManager::searchPictures()
+{
+	std::string query = getInputFromConsole("Enter words to search for: ");
 
-	auto taggedPictures = m_dataAccess.getTaggedPicturesOfUser(user);
+	const auto pictures = m_dataAccess.searchPictures(query, LIST_PAGE_SIZE);
+	if (pictures.empty()) {
+		std::cout << "No pictures match <" << query << ">." << std::endl;
+		return;
+	}
 
-	std::cout << "List of pictures that User@" << user.getId() << " tagged :" << std::endl;
-	for (const Picture& picture: taggedPictures) {
+	std::cout << "Pictures matching <" << query << ">:" << std::endl;
+	for (const auto& picture : pictures) {
 		std::cout << "   + " << picture << std::endl;
 	}
 	std::cout << std::endl;
 }
 
 
+// ******************* Database ******************* 
+void AlbumManager::queryProfile()
+{
+	m_dataAccess.printQueryProfile(std::cout);
+
+	std::string path = getInputFromConsole("Enter a file to save the profile to (n to skip): ");
+	if (path == "n" || path == "N") {
+		return;
+	}
+
+	std::ofstream file(path);
+	if (!file) {
+		throw MyException("Error: Can't open <" + path + "> for writing.\n");
+	}
+	m_dataAccess.printQueryProfile(file);
+	std::cout << "Query profile saved to <" << path << ">." << std::endl;
+}
+
+void AlbumManager::backup()
+{
+	std::string path = getInputFromConsole("Enter a file to back the gallery up to: ");
+	m_dataAccess.startBackup(path);
+	std::cout << "Backup to <" << path << "> started, the gallery can be used meanwhile." << std::endl;
+}
+
+void AlbumManager::backupStatus()
+{
+	const BackupProgress progress = m_dataAccess.getBackupProgress();
+	if (progress.path.empty()) {
+		std::cout << "No backup was started." << std::endl;
+		return;
+	}
+
+	if (progress.running) {
+		std::cout << "Backing up to <" << progress.path << ">: " << progress.pagesCopied << "/" << progress.pageCount << " pages";
+		if (progress.pageCount > 0) {
+			std::cout << " (" << progress.pagesCopied * 100LL / progress.pageCount << "%)";
+		}
+		std::cout << std::endl;
+	}
+	else if (!progress.error.empty()) {
+		std::cout << "Backup to <" << progress.path << "> failed: " << progress.error << std::endl;
+	}
+	else {
+		std::cout << "Backup to <" << progress.path << "> is complete, " << progress.pageCount << " pages copied." << std::endl;
+	}
+}
+
+void AlbumManager::maintainDatabase()
+{
+	// asked for by the user, so an old file may be rewritten once to switch it to incremental vacuum
+	const MaintenanceReport report = m_dataAccess.runMaintenance(true);
+	std::cout << "Query planner statistics are up to date." << std::endl;
+	if (report.vacuumed) {
+		std::cout << "Vacuumed " << report.freelistPages << " unused pages, " << report.bytesReclaimed << " bytes reclaimed." << std::endl;
+	}
+	else {
+		std::cout << report.freelistPages << " unused pages, too few to vacuum yet." << std::endl;
+	}
+}
+
 // ******************* Help & exit ******************* 
 void AlbumManager::exit()
 {
+	// std::exit skips the destructors, anything still held back is written now
+	try {
+		m_dataAccess.close();
+	}
+	catch (const std::exception& e) {
+		std::cout << e.what() << std::endl; // the store is closed either way, only the failed tags are lost
+	}
 	std::exit(EXIT_SUCCESS);
 }
 
@@ -510,6 +657,27 @@ int AlbumManager::getIntInputFromConsole(const std::string& message)
 	return std::stoi(input);
 }
 
+long long AlbumManager::getDateInputFromConsole(const std::string& message, bool endOfDay)
+{
+	while (true) {
+		std::tm date = {};
+		std::istringstream input(getInputFromConsole(message));
+		input >> std::get_time(&date, "%d/%m/%Y");
+		if (input.fail()) {
+			std::cout << "Input is not a dd/mm/yyyy date!" << std::endl;
+			continue;
+		}
+
+		date.tm_isdst = -1; // the dates are local, let mktime work out daylight saving
+		if (endOfDay) {
+			date.tm_hour = 23;
+			date.tm_min = 59;
+			date.tm_sec = 59;
+		}
+		return (long long)std::mktime(&date);
+	}
+}
+
 bool AlbumManager::fileExistsOnDisk(const std::string& filename)
 {
 	struct stat buffer;   
@@ -520,12 +688,38 @@ void AlbumManager::refreshOpenAlbum() {
 	if (!isCurrentAlbumSet()) {
 		throw AlbumNotOpenException();
 	}
-    m_openAlbum = m_dataAccess.openAlbum(m_currentAlbumName);
+	// only reload when something was written since the album was loaded
+	long long version = m_dataAccess.getDataVersion();
+	if (version != m_openAlbumVersion) {
+		m_openAlbum = m_dataAccess.openAlbum(m_currentAlbumId);
+		m_openAlbumVersion = version;
+	}
 }
 
 bool AlbumManager::isCurrentAlbumSet() const
 {
-    return !m_currentAlbumName.empty();
+    return m_currentAlbumId != -1;
+}
+
+template <typename T>
+void AlbumManager::printPaged(const std::function<std::list<T>(int afterId)>& getPage, const std::function<void(const T&)>& print)
+{
+	int afterId = -1; // before any id, so the first page starts at the beginning
+	while (true) {
+		std::list<T> page = getPage(afterId);
+		for (const T& item : page) {
+			print(item);
+		}
+		if (page.size() < (size_t)LIST_PAGE_SIZE) {
+			return;
+		}
+
+		afterId = page.back().getId();
+		std::string more = getInputFromConsole("Show more? (y/n): ");
+		if (more != "y" && more != "Y") {
+			return;
+		}
+	}
 }
 
 const std::vector<struct CommandGroup> AlbumManager::m_prompts  = {
@@ -549,8 +743,11 @@ const std::vector<struct CommandGroup> AlbumManager::m_prompts  = {
 			{ MAKE_READONLY  , "Set picture read-only attribute."},
 			{ COPY_PICTURE   , "Make a copy of a picture."},
 			{ LIST_PICTURES  , "List pictures." },
+			{ LIST_PICTURES_CREATED_BETWEEN , "List pictures created between dates." },
 			{ TAG_USER		 , "Tag user." },
 			{ UNTAG_USER	 , "Untag user." },
+			{ TAG_USER_IN_ALBUM   , "Tag user in all pictures." },
+			{ UNTAG_USER_IN_ALBUM , "Untag user in all pictures." },
 			{ LIST_TAGS		 , "List tags." }
 		}
 	},
@@ -569,6 +766,17 @@ const std::vector<struct CommandGroup> AlbumManager::m_prompts  = {
 			{ TOP_TAGGED_USER      , "Top tagged user." },
 			{ TOP_TAGGED_PICTURE   , "Top tagged picture." },
 			{ PICTURES_TAGGED_USER , "Pictures tagged user." },
+			{ SEARCH_PICTURES      , "Search pictures." },
+			{ PICTURES_CREATED_BETWEEN , "Pictures created between dates." },
+		}
+	},
+	{
+		"Supported Database commands:",
+		{
+			{ QUERY_PROFILE , "Query latency profile." },
+			{ BACKUP , "Back the gallery up to a file." },
+			{ BACKUP_STATUS , "Backup progress." },
+			{ MAINTAIN_DATABASE , "Refresh planner statistics and reclaim unused space." },
 		}
 	},
 	{
@@ -590,11 +798,14 @@ const std::map<CommandType, AlbumManager::handler_func_t> AlbumManager::m_comman
 	{ ADD_PICTURE, &AlbumManager::addPictureToAlbum },
 	{ REMOVE_PICTURE, &AlbumManager::removePictureFromAlbum },
 	{ LIST_PICTURES, &AlbumManager::listPicturesInAlbum },
+	{ LIST_PICTURES_CREATED_BETWEEN, &AlbumManager::listPicturesCreatedBetween },
 	{ SHOW_PICTURE, &AlbumManager::showPicture },
 	{ MAKE_READONLY, &AlbumManager::makeReadOnly },
 	{ COPY_PICTURE, &AlbumManager::copyPicture },
 	{ TAG_USER, &AlbumManager::tagUserInPicture, },
 	{ UNTAG_USER, &AlbumManager::untagUserInPicture },
+	{ TAG_USER_IN_ALBUM, &AlbumManager::tagUserInAlbum },
+	{ UNTAG_USER_IN_ALBUM, &AlbumManager::untagUserInAlbum },
 	{ LIST_TAGS, &AlbumManager::listUserTags },
 	{ ADD_USER, &AlbumManager::addUser },
 	{ REMOVE_USER, &AlbumManager::removeUser },
@@ -603,6 +814,12 @@ const std::map<CommandType, AlbumManager::handler_func_t> AlbumManager::m_comman
 	{ TOP_TAGGED_USER, &AlbumManager::topTaggedUser },
 	{ TOP_TAGGED_PICTURE, &AlbumManager::topTaggedPicture },
 	{ PICTURES_TAGGED_USER, &AlbumManager::picturesTaggedUser },
+	{ SEARCH_PICTURES, &AlbumManager::searchPictures },
+	{ PICTURES_CREATED_BETWEEN, &AlbumManager::picturesCreatedBetween },
+	{ QUERY_PROFILE, &AlbumManager::queryProfile },
+	{ BACKUP, &AlbumManager::backup },
+	{ BACKUP_STATUS, &AlbumManager::backupStatus },
+	{ MAINTAIN_DATABASE, &AlbumManager::maintainDatabase },
 	{ HELP, &AlbumManager::help },
 	{ EXIT, &AlbumManager::exit }
 };
@@ -16,11 +16,11 @@ public:
 	using handler_func_t = void (AlbumManager::*)(void);    
 
 private:
-    int m_nextPictureId{};
     int m_nextUserId{};
-    std::string m_currentAlbumName{};
+    int m_currentAlbumId{ -1 };
 	IDataAccess& m_dataAccess;
 	Album m_openAlbum;
+	long long m_openAlbumVersion{ -1 }; // data version m_openAlbum was loaded at
 
 	void help();
 	// albums management
@@ -35,6 +35,7 @@ private:
 	void addPictureToAlbum();
 	void removePictureFromAlbum();
 	void listPicturesInAlbum();
+	void listPicturesCreatedBetween();
 	void showPicture();
 	static BOOL WINAPI CtrlCHandler(DWORD fdwCtrlType);
 	void makeReadOnly();
@@ -43,6 +44,8 @@ private:
 	// tags related
 	void tagUserInPicture();
 	void untagUserInPicture();
+	void tagUserInAlbum();
+	void untagUserInAlbum();
 	void listUserTags();
 
 	// users management
@@ -54,13 +57,26 @@ private:
 	void topTaggedUser();
 	void topTaggedPicture();
 	void picturesTaggedUser();
+	void searchPictures();
+	void picturesCreatedBetween();
+
+	// database
+	void queryProfile();
+	void backup();
+	void backupStatus();
+	void maintainDatabase();
 	void exit();
 
 	std::string getInputFromConsole(const std::string& message);
 	int getIntInputFromConsole(const std::string& message);
+	long long getDateInputFromConsole(const std::string& message, bool endOfDay);
 	bool fileExistsOnDisk(const std::string& filename);
 	void refreshOpenAlbum();
     bool isCurrentAlbumSet() const;
+	template <typename T>
+	void printPaged(const std::function<std::list<T>(int afterId)>& getPage, const std::function<void(const T&)>& print);
+
+	static const int LIST_PAGE_SIZE = 20;
 
 	static const std::vector<struct CommandGroup> m_prompts;
 	static const std::map<CommandType, handler_func_t> m_commands;
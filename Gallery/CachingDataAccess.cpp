@@ -0,0 +1,516 @@
+#include "CachingDataAccess.h"
+#include <iomanip>
+
+static size_t weighAlbum(const Album& album)
+{
+	return album.getPicturesCount() + 1;
+}
+
+CachingDataAccess::CachingDataAccess(IDataAccess& dataAccess, size_t capacity, size_t pictureCapacity)
+	: m_dataAccess(dataAccess), m_users(capacity), m_userExists(capacity), m_albumExists(capacity),
+	m_albumsByName(pictureCapacity, weighAlbum), m_albumsById(pictureCapacity, weighAlbum),
+	m_albumsByOwner(pictureCapacity, weighAlbum)
+{
+}
+
+// ******************* Cache invalidation ******************* 
+// entries are dropped before the write is passed on, so a write that fails half way leaves nothing stale
+
+void CachingDataAccess::forgetAlbumsWhere(const std::function<bool(const Album&)>& predicate)
+{
+	m_albumsByName.eraseIf([&](const std::string&, const Album& album) { return predicate(album); });
+	m_albumsById.eraseIf([&](int, const Album& album) { return predicate(album); });
+	m_albumsByOwner.eraseIf([&](const std::pair<std::string, int>&, const Album& album) { return predicate(album); });
+}
+
+void CachingDataAccess::forgetAlbums(const std::string& albumName)
+{
+	m_albumsByName.erase(albumName);
+	forgetAlbumsWhere([&](const Album& album) { return album.getName() == albumName; });
+}
+
+void CachingDataAccess::forgetAlbum(int albumId)
+{
+	m_albumsById.erase(albumId);
+	forgetAlbumsWhere([&](const Album& album) { return album.getId() == albumId; });
+}
+
+void CachingDataAccess::forgetAlbumOfPicture(int pictureId)
+{
+	forgetAlbumsWhere([&](const Album& album) { return album.doesPictureExists(pictureId); });
+}
+
+// a change of the version before a lookup or a write was made by someone else, the one a write makes is ours
+void CachingDataAccess::checkVersion()
+{
+	getDataVersion();
+}
+
+void CachingDataAccess::afterWrite()
+{
+	m_knownVersion = m_dataAccess.getDataVersion();
+}
+
+void CachingDataAccess::forgetAll()
+{
+	m_users.clear();
+	m_userExists.clear();
+	m_albumExists.clear();
+	m_albumsByName.clear();
+	m_albumsById.clear();
+	m_albumsByOwner.clear();
+}
+
+// ******************* Album ******************* 
+std::list<Album> CachingDataAccess::getAlbums()
+{
+	return m_dataAccess.getAlbums();
+}
+
+std::list<Album> CachingDataAccess::getAlbumsOfUser(const User& user)
+{
+	return m_dataAccess.getAlbumsOfUser(user);
+}
+
+void CachingDataAccess::createAlbum(const Album& album)
+{
+	m_albumExists.erase({ album.getName(), album.getOwnerId() });
+	forgetAlbums(album.getName());
+	checkVersion();
+	m_dataAccess.createAlbum(album);
+	afterWrite();
+}
+
+void CachingDataAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	m_albumExists.erase({ albumName, userId });
+	forgetAlbums(albumName);
+	checkVersion();
+	m_dataAccess.deleteAlbum(albumName, userId);
+	afterWrite();
+}
+
+bool CachingDataAccess::doesAlbumExists(const std::string& albumName, int userId)
+{
+	checkVersion();
+	const auto key = std::make_pair(albumName, userId);
+	if (const bool* exists = m_albumExists.find(key)) {
+		return *exists;
+	}
+	bool exists = m_dataAccess.doesAlbumExists(albumName, userId);
+	m_albumExists.put(key, exists);
+	return exists;
+}
+
+Album CachingDataAccess::openAlbum(const std::string& albumName)
+{
+	checkVersion();
+	if (const Album* album = m_albumsByName.find(albumName)) {
+		return *album;
+	}
+	Album album = m_dataAccess.openAlbum(albumName);
+	m_albumsByName.put(albumName, album);
+	return album;
+}
+
+Album CachingDataAccess::openAlbum(int albumId)
+{
+	checkVersion();
+	if (const Album* album = m_albumsById.find(albumId)) {
+		return *album;
+	}
+	Album album = m_dataAccess.openAlbum(albumId);
+	m_albumsById.put(albumId, album);
+	return album;
+}
+
+std::optional<Album> CachingDataAccess::findAlbum(const std::string& albumName, int ownerId)
+{
+	checkVersion();
+	const auto key = std::make_pair(albumName, ownerId);
+	if (const Album* album = m_albumsByOwner.find(key)) {
+		return *album;
+	}
+	const bool* exists = m_albumExists.find(key);
+	if (exists != nullptr && !*exists) {
+		return std::nullopt;
+	}
+	std::optional<Album> album = m_dataAccess.findAlbum(albumName, ownerId);
+	m_albumExists.put(key, album.has_value());
+	if (album) {
+		m_albumsByOwner.put(key, *album);
+	}
+	return album;
+}
+
+int CachingDataAccess::findAlbumId(const std::string& albumName, int userId)
+{
+	return m_dataAccess.findAlbumId(albumName, userId);
+}
+
+void CachingDataAccess::closeAlbum(Album& pAlbum)
+{
+	m_dataAccess.closeAlbum(pAlbum);
+}
+
+void CachingDataAccess::printAlbums()
+{
+	m_dataAccess.printAlbums();
+}
+
+void CachingDataAccess::forEachAlbum(const std::function<void(const Album&)>& visit)
+{
+	m_dataAccess.forEachAlbum(visit);
+}
+
+void CachingDataAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit)
+{
+	m_dataAccess.forEachAlbumOfUser(user, visit);
+}
+
+void CachingDataAccess::forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit)
+{
+	m_dataAccess.forEachTaggedPictureOfUser(user, visit);
+}
+
+std::list<Album> CachingDataAccess::getAlbums(int afterId, int limit)
+{
+	return m_dataAccess.getAlbums(afterId, limit);
+}
+
+std::list<User> CachingDataAccess::getUsers(int afterId, int limit)
+{
+	return m_dataAccess.getUsers(afterId, limit);
+}
+
+std::list<Picture> CachingDataAccess::getPicturesOfAlbum(int albumId, int afterId, int limit)
+{
+	return m_dataAccess.getPicturesOfAlbum(albumId, afterId, limit);
+}
+
+std::list<Picture> CachingDataAccess::getPicturesCreatedBetween(long long from, long long to)
+{
+	return m_dataAccess.getPicturesCreatedBetween(from, to);
+}
+
+std::list<Picture> CachingDataAccess::getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to)
+{
+	return m_dataAccess.getPicturesOfAlbumCreatedBetween(albumId, from, to);
+}
+
+// ******************* Picture ******************* 
+void CachingDataAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	forgetAlbums(albumName);
+	checkVersion();
+	m_dataAccess.addPictureToAlbumByName(albumName, picture);
+	afterWrite();
+}
+
+void CachingDataAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	forgetAlbums(albumName);
+	checkVersion();
+	m_dataAccess.removePictureFromAlbumByName(albumName, pictureName);
+	afterWrite();
+}
+
+void CachingDataAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	forgetAlbums(albumName);
+	checkVersion();
+	m_dataAccess.tagUserInPicture(albumName, pictureName, userId);
+	afterWrite();
+}
+
+void CachingDataAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	forgetAlbums(albumName);
+	checkVersion();
+	m_dataAccess.untagUserInPicture(albumName, pictureName, userId);
+	afterWrite();
+}
+
+void CachingDataAccess::addPictureToAlbum(int albumId, Picture& picture)
+{
+	forgetAlbum(albumId);
+	checkVersion();
+	m_dataAccess.addPictureToAlbum(albumId, picture);
+	afterWrite();
+}
+
+void CachingDataAccess::removePicture(int pictureId)
+{
+	forgetAlbumOfPicture(pictureId);
+	checkVersion();
+	m_dataAccess.removePicture(pictureId);
+	afterWrite();
+}
+
+void CachingDataAccess::tagUser(int pictureId, int userId)
+{
+	forgetAlbumOfPicture(pictureId);
+	checkVersion();
+	m_dataAccess.tagUser(pictureId, userId);
+	afterWrite();
+}
+
+void CachingDataAccess::untagUser(int pictureId, int userId)
+{
+	forgetAlbumOfPicture(pictureId);
+	checkVersion();
+	m_dataAccess.untagUser(pictureId, userId);
+	afterWrite();
+}
+
+void CachingDataAccess::tagUserInAlbum(int albumId, int userId)
+{
+	forgetAlbum(albumId);
+	checkVersion();
+	m_dataAccess.tagUserInAlbum(albumId, userId);
+	afterWrite();
+}
+
+void CachingDataAccess::untagUserInAlbum(int albumId, int userId)
+{
+	forgetAlbum(albumId);
+	checkVersion();
+	m_dataAccess.untagUserInAlbum(albumId, userId);
+	afterWrite();
+}
+
+// ******************* User ******************* 
+void CachingDataAccess::printUsers()
+{
+	m_dataAccess.printUsers();
+}
+
+User CachingDataAccess::getUser(int userId)
+{
+	checkVersion();
+	if (const User* user = m_users.find(userId)) {
+		return *user;
+	}
+	User user = m_dataAccess.getUser(userId);
+	m_users.put(userId, user);
+	return user;
+}
+
+std::optional<User> CachingDataAccess::findUser(int userId)
+{
+	checkVersion();
+	if (const User* user = m_users.find(userId)) {
+		return *user;
+	}
+	const bool* exists = m_userExists.find(userId);
+	if (exists != nullptr && !*exists) {
+		return std::nullopt;
+	}
+	std::optional<User> user = m_dataAccess.findUser(userId);
+	m_userExists.put(userId, user.has_value());
+	if (user) {
+		m_users.put(userId, *user);
+	}
+	return user;
+}
+
+void CachingDataAccess::createUser(User& user)
+{
+	checkVersion();
+	m_dataAccess.createUser(user);
+	afterWrite();
+	// the id is only known now, a cached "doesn't exist" for it is stale
+	m_userExists.erase(user.getId());
+	m_users.erase(user.getId());
+}
+
+void CachingDataAccess::deleteUser(const User& user)
+{
+	const int userId = user.getId();
+	m_users.erase(userId);
+	m_userExists.erase(userId);
+	// the user's albums go with them and their tags leave every other album
+	m_albumExists.eraseIf([&](const std::pair<std::string, int>& key, bool) { return key.second == userId; });
+	forgetAlbumsWhere([&](const Album& album) { return album.getOwnerId() == userId || album.isUserTaggedInAlbum(userId); });
+	checkVersion();
+	m_dataAccess.deleteUser(user);
+	afterWrite();
+}
+
+bool CachingDataAccess::doesUserExists(int userId)
+{
+	checkVersion();
+	if (const bool* exists = m_userExists.find(userId)) {
+		return *exists;
+	}
+	bool exists = m_dataAccess.doesUserExists(userId);
+	m_userExists.put(userId, exists);
+	return exists;
+}
+
+// ******************* Statistics & queries ******************* 
+int CachingDataAccess::countAlbumsOwnedOfUser(const User& user)
+{
+	return m_dataAccess.countAlbumsOwnedOfUser(user);
+}
+
+int CachingDataAccess::countAlbumsTaggedOfUser(const User& user)
+{
+	return m_dataAccess.countAlbumsTaggedOfUser(user);
+}
+
+int CachingDataAccess::countTagsOfUser(const User& user)
+{
+	return m_dataAccess.countTagsOfUser(user);
+}
+
+float CachingDataAccess::averageTagsPerAlbumOfUser(const User& user)
+{
+	return m_dataAccess.averageTagsPerAlbumOfUser(user);
+}
+
+UserStatistics CachingDataAccess::getUserStatistics(const User& user)
+{
+	return m_dataAccess.getUserStatistics(user);
+}
+
+User CachingDataAccess::getTopTaggedUser()
+{
+	return m_dataAccess.getTopTaggedUser();
+}
+
+Picture CachingDataAccess::getTopTaggedPicture()
+{
+	return m_dataAccess.getTopTaggedPicture();
+}
+
+std::list<User> CachingDataAccess::getTopTaggedUsers(int count)
+{
+	return m_dataAccess.getTopTaggedUsers(count);
+}
+
+std::list<Picture> CachingDataAccess::getTopTaggedPictures(int count)
+{
+	return m_dataAccess.getTopTaggedPictures(count);
+}
+
+std::list<Picture> CachingDataAccess::getTaggedPicturesOfUser(const User& user)
+{
+	return m_dataAccess.getTaggedPicturesOfUser(user);
+}
+
+std::list<Picture> CachingDataAccess::searchPictures(const std::string& query, int limit)
+{
+	return m_dataAccess.searchPictures(query, limit);
+}
+
+// ******************* Batches, diagnostics & lifetime ******************* 
+void CachingDataAccess::beginBatch()
+{
+	m_dataAccess.beginBatch();
+}
+
+void CachingDataAccess::commitBatch()
+{
+	m_dataAccess.commitBatch();
+}
+
+void CachingDataAccess::rollbackBatch()
+{
+	// anything read since the batch began may have seen writes that are now undone
+	forgetAll();
+	m_dataAccess.rollbackBatch();
+	afterWrite();
+}
+
+long long CachingDataAccess::getDataVersion()
+{
+	long long version = m_dataAccess.getDataVersion();
+	if (version != m_knownVersion) {
+		forgetAll(); // changed without passing through here
+		m_knownVersion = version;
+	}
+	return version;
+}
+
+void CachingDataAccess::printQueryProfile(std::ostream& out)
+{
+	printCacheStatistics(out);
+	out << std::endl;
+	m_dataAccess.printQueryProfile(out);
+}
+
+template <typename Key, typename Value>
+static void printCacheLine(std::ostream& out, const char* name, const LruCache<Key, Value>& cache)
+{
+	const long long lookups = cache.getHits() + cache.getMisses();
+	out << std::setw(18) << name << std::setw(10) << cache.getHits() << std::setw(10) << cache.getMisses()
+		<< std::setw(9) << (lookups == 0 ? 0 : cache.getHits() * 100 / lookups) << "%" << std::setw(10) << cache.size()
+		<< std::setw(10) << cache.weight() << std::endl;
+}
+
+void CachingDataAccess::printCacheStatistics(std::ostream& out) const
+{
+	out << std::setw(18) << "cache" << std::setw(10) << "hits" << std::setw(10) << "misses"
+		<< std::setw(10) << "hit rate" << std::setw(10) << "entries" << std::setw(10) << "weight" << std::endl;
+	printCacheLine(out, "getUser", m_users);
+	printCacheLine(out, "doesUserExists", m_userExists);
+	printCacheLine(out, "doesAlbumExists", m_albumExists);
+	printCacheLine(out, "openAlbum(name)", m_albumsByName);
+	printCacheLine(out, "openAlbum(id)", m_albumsById);
+	printCacheLine(out, "findAlbum", m_albumsByOwner);
+}
+
+template <typename Key, typename Value>
+static void addCacheStatistics(CachingDataAccess::CacheStatistics& statistics, const LruCache<Key, Value>& cache)
+{
+	statistics.hits += cache.getHits();
+	statistics.misses += cache.getMisses();
+	statistics.entries += cache.size();
+}
+
+CachingDataAccess::CacheStatistics CachingDataAccess::getCacheStatistics() const
+{
+	CacheStatistics statistics;
+	addCacheStatistics(statistics, m_users);
+	addCacheStatistics(statistics, m_userExists);
+	addCacheStatistics(statistics, m_albumExists);
+	addCacheStatistics(statistics, m_albumsByName);
+	addCacheStatistics(statistics, m_albumsById);
+	addCacheStatistics(statistics, m_albumsByOwner);
+	return statistics;
+}
+
+void CachingDataAccess::startBackup(const std::string& path)
+{
+	m_dataAccess.startBackup(path);
+}
+
+BackupProgress CachingDataAccess::getBackupProgress()
+{
+	return m_dataAccess.getBackupProgress();
+}
+
+MaintenanceReport CachingDataAccess::runMaintenance(bool allowFullVacuum)
+{
+	return m_dataAccess.runMaintenance(allowFullVacuum);
+}
+
+bool CachingDataAccess::open()
+{
+	forgetAll();
+	return m_dataAccess.open();
+}
+
+void CachingDataAccess::close()
+{
+	forgetAll();
+	m_dataAccess.close();
+}
+
+void CachingDataAccess::clear()
+{
+	forgetAll();
+	m_dataAccess.clear();
+	afterWrite();
+}
@@ -0,0 +1,135 @@
+#pragma once
+#include <string>
+#include <utility>
+#include "IDataAccess.h"
+#include "LruCache.h"
+
+// Wraps another data access and keeps the results of the lookups commands repeat the most -
+// getUser, findUser, doesUserExists, doesAlbumExists, openAlbum and findAlbum - in bounded LRU caches.
+// Every write that passes through drops the entries it can change. Writes made around it, like the
+// commits of another connection, move the data version of the wrapped data access - it is checked
+// before every cached lookup and write, and a move nobody made through here drops all the entries.
+// The album caches are bounded by the pictures they hold, an album weighs its picture count plus one.
+class CachingDataAccess : public IDataAccess
+{
+public:
+	static const size_t DEFAULT_CAPACITY = 256;          // entries per user and existence cache
+	static const size_t DEFAULT_PICTURE_CAPACITY = 4096; // pictures per album cache
+
+	struct CacheStatistics
+	{
+		long long hits{ 0 };
+		long long misses{ 0 };
+		size_t entries{ 0 };
+
+		double hitRate() const { return hits + misses == 0 ? 0.0 : (double)hits / (hits + misses); }
+	};
+
+	explicit CachingDataAccess(IDataAccess& dataAccess, size_t capacity = DEFAULT_CAPACITY,
+		size_t pictureCapacity = DEFAULT_PICTURE_CAPACITY);
+	virtual ~CachingDataAccess() = default;
+
+	// album related
+	std::list<Album> getAlbums() override;
+	std::list<Album> getAlbumsOfUser(const User& user) override;
+	void createAlbum(const Album& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+	bool doesAlbumExists(const std::string& albumName, int userId) override;
+	Album openAlbum(const std::string& albumName) override;
+	Album openAlbum(int albumId) override;
+	int findAlbumId(const std::string& albumName, int userId) override;
+	std::optional<Album> findAlbum(const std::string& albumName, int ownerId) override;
+	void closeAlbum(Album& pAlbum) override;
+	void printAlbums() override;
+
+	// streaming
+	void forEachAlbum(const std::function<void(const Album&)>& visit) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit) override;
+	void forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit) override;
+
+	// paging
+	std::list<Album> getAlbums(int afterId, int limit) override;
+	std::list<User> getUsers(int afterId, int limit) override;
+	std::list<Picture> getPicturesOfAlbum(int albumId, int afterId, int limit) override;
+
+	// creation time ranges
+	std::list<Picture> getPicturesCreatedBetween(long long from, long long to) override;
+	std::list<Picture> getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void addPictureToAlbum(int albumId, Picture& picture) override;
+	void removePicture(int pictureId) override;
+	void tagUser(int pictureId, int userId) override;
+	void untagUser(int pictureId, int userId) override;
+	void tagUserInAlbum(int albumId, int userId) override;
+	void untagUserInAlbum(int albumId, int userId) override;
+
+	// user related
+	void printUsers() override;
+	User getUser(int userId) override;
+	std::optional<User> findUser(int userId) override;
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+	bool doesUserExists(int userId) override;
+
+	// user statistics
+	int countAlbumsOwnedOfUser(const User& user) override;
+	int countAlbumsTaggedOfUser(const User& user) override;
+	int countTagsOfUser(const User& user) override;
+	float averageTagsPerAlbumOfUser(const User& user) override;
+	UserStatistics getUserStatistics(const User& user) override;
+
+	// queries
+	User getTopTaggedUser() override;
+	Picture getTopTaggedPicture() override;
+	std::list<User> getTopTaggedUsers(int count) override;
+	std::list<Picture> getTopTaggedPictures(int count) override;
+	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+	std::list<Picture> searchPictures(const std::string& query, int limit) override;
+
+	// write batches
+	void beginBatch() override;
+	void commitBatch() override;
+	void rollbackBatch() override;
+
+	// change detection
+	long long getDataVersion() override;
+
+	// diagnostics - the cache hit rates come before the profile of the wrapped data access
+	void printQueryProfile(std::ostream& out) override;
+	void printCacheStatistics(std::ostream& out) const;
+	CacheStatistics getCacheStatistics() const; // summed over all the caches
+
+	// backup
+	void startBackup(const std::string& path) override;
+	BackupProgress getBackupProgress() override;
+
+	// maintenance
+	MaintenanceReport runMaintenance(bool allowFullVacuum) override;
+
+	bool open() override;
+	void close() override;
+	void clear() override;
+
+private:
+	void forgetAlbumsWhere(const std::function<bool(const Album&)>& predicate);
+	void forgetAlbums(const std::string& albumName);
+	void forgetAlbum(int albumId);
+	void forgetAlbumOfPicture(int pictureId);
+	void forgetAll();
+	void checkVersion();
+	void afterWrite();
+
+	IDataAccess& m_dataAccess;
+	long long m_knownVersion{ -1 }; // version of the wrapped data the caches were filled from
+	LruCache<int, User> m_users;
+	LruCache<int, bool> m_userExists;
+	LruCache<std::pair<std::string, int>, bool> m_albumExists; // (album name, owner id)
+	LruCache<std::string, Album> m_albumsByName;
+	LruCache<int, Album> m_albumsById;
+	LruCache<std::pair<std::string, int>, Album> m_albumsByOwner; // (album name, owner id)
+};
@@ -21,8 +21,11 @@ enum CommandType
 	MAKE_READONLY,
 	COPY_PICTURE,
 	LIST_PICTURES,
+	LIST_PICTURES_CREATED_BETWEEN,
 	TAG_USER,
 	UNTAG_USER,
+	TAG_USER_IN_ALBUM,
+	UNTAG_USER_IN_ALBUM,
 	LIST_TAGS,
 
 	// User operations
@@ -35,6 +38,14 @@ enum CommandType
 	TOP_TAGGED_USER,
 	TOP_TAGGED_PICTURE,
 	PICTURES_TAGGED_USER,
+	SEARCH_PICTURES,
+	PICTURES_CREATED_BETWEEN,
+
+	// Database operations
+	QUERY_PROFILE,
+	BACKUP,
+	BACKUP_STATUS,
+	MAINTAIN_DATABASE,
 
 	EXIT = 99
 };
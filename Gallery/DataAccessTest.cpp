@@ -1,11 +1,12 @@
 #include "DataAccessTest.h"
-#include <cstdio>
+#include <regex>
+#include <set>
+#include "CachingDataAccess.h"
 #include "SQLException.h"
 
 DataAccessTest::DataAccessTest()
+	: _dba(_dbFileName)
 {
-	std::remove(_dbFileName);
-	_dba = DatabaseAccess(_dbFileName);
 }
 
 DataAccessTest::~DataAccessTest()
@@ -26,6 +27,12 @@ void DataAccessTest::runTests()
 
 	std::cout << "--DELETE ROWS TEST--" << std::endl;
 	removeRows();
+
+	std::cout << "--QUERY PLAN TEST--" << std::endl;
+	queryPlans();
+
+	std::cout << "--CACHE TEST--" << std::endl;
+	cacheHitRate();
 }
 
 void DataAccessTest::createTables()
@@ -45,33 +52,43 @@ void DataAccessTest::createTables()
 void DataAccessTest::addRows()
 {
 	std::cout << "Adding users and albums:" << std::endl;
+	// all users exist before the albums, since the albums tag them
 	for (int i = 1; i <= 3; i++)
 	{
 		try
 		{
 			std::cout << "\tCreating user " << i << ":" << std::endl;
-			_dba.createUser(User(i, "user" + std::to_string(i)));
+			User user(i, "user" + std::to_string(i));
+			_dba.createUser(user);
 			std::cout << "SUCCESS!" << std::endl;
 		}
 		catch (const std::exception& e)
 		{
 			std::cerr << "FAILED! Error - " << e.what() << std::endl;
 		}
+	}
+	for (int i = 1; i <= 3; i++)
+	{
 		Album album(i, "album" + std::to_string(i));
 		album.setCreationDateNow();
 		for (int j = 1; j <= 2; j++)
 		{
 			const auto& id = std::to_string(i) + std::to_string(j);
-			Picture pic(std::stoi(id), "pic" + id, "C:/Pictures/" + id + ".png", "");
+			Picture pic(std::stoi(id), "pic" + id, "C:/Pictures/" + id + ".png", 0);
 			pic.setCreationDateNow();
 			pic.tagUser(i % 3 + 1);
-			pic.tagUser((i % 3 + 2) % 3);
+			pic.tagUser((i + 1) % 3 + 1);
 			album.addPicture(pic);
 		}
 		try
 		{
 			std::cout << "\tCreating album " << i << ":" << std::endl;
 			_dba.createAlbum(album);
+			const Album& created = _dba.openAlbum(album.getName());
+			if (created.getPictures().size() != 2 || created.getPicture("pic" + std::to_string(i) + "1").getTagsCount() != 2)
+			{
+				throw SQLException("album pictures or tags were not stored");
+			}
 			std::cout << "SUCCESS!" << std::endl;
 		}
 		catch (const std::exception& e)
@@ -83,7 +100,7 @@ void DataAccessTest::addRows()
 
 void DataAccessTest::updateRows()
 {
-	Picture pic(69, "my femily", "C:/Pictures/myfamily.png", "");
+	Picture pic(69, "my femily", "C:/Pictures/myfamily.png", 0);
 	pic.setCreationDateNow();
 	try
 	{
@@ -149,3 +166,111 @@ void DataAccessTest::removeRows()
 		std::cerr << "FAILED! Error - " << e.what() << std::endl;
 	}
 }
+
+void DataAccessTest::queryPlans()
+{
+	try
+	{
+		std::cout << "Running every query:" << std::endl;
+		// the plans are taken from the prepared statement cache, so every query has to run once first
+		const User user = _dba.getUser(1);
+		_dba.doesUserExists(1);
+		_dba.getUsers(-1, 10);
+		_dba.getAlbums();
+		_dba.getAlbums(-1, 10);
+		_dba.getAlbumsOfUser(user);
+		const Album album = _dba.openAlbum(_dba.findAlbumId("album1", 1));
+		_dba.findAlbum("album1", 1);
+		_dba.getPicturesOfAlbum(album.getId(), -1, 10);
+		_dba.getPicturesCreatedBetween(0, album.getCreationTime());
+		_dba.getPicturesOfAlbumCreatedBetween(album.getId(), 0, album.getCreationTime());
+		_dba.tagUserInPicture("album1", "My Family", 1);
+		_dba.untagUserInPicture("album1", "My Family", 1);
+		Picture picture(0, "plan");
+		_dba.addPictureToAlbum(album.getId(), picture);
+		_dba.tagUser(picture.getId(), 1);
+		_dba.untagUser(picture.getId(), 1);
+		_dba.removePicture(picture.getId());
+		_dba.tagUserInAlbum(album.getId(), 3);
+		_dba.untagUserInAlbum(album.getId(), 3);
+		_dba.getTaggedPicturesOfUser(user);
+		_dba.countAlbumsOwnedOfUser(user);
+		_dba.countAlbumsTaggedOfUser(user);
+		_dba.countTagsOfUser(user);
+		_dba.averageTagsPerAlbumOfUser(user);
+		_dba.getUserStatistics(user);
+		_dba.getTopTaggedUsers(3);
+		_dba.getTopTaggedPictures(3);
+		_dba.searchPictures("pic", 10);
+		std::cout << "SUCCESS!" << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "FAILED! Error - " << e.what() << std::endl;
+	}
+
+	std::cout << "Checking query plans for full table scans:" << std::endl;
+	// a name in the plan is the table itself or the alias the query gave it
+	static const std::regex tableName("\\b(Tags|Pictures|Albums)\\b(?:\\s+AS)?(?:\\s+(\\w+))?", std::regex::icase);
+	// walking a whole index is as much O(n) as walking the table
+	static const std::regex fullScan("^SCAN (\\w+)(?: USING (?:COVERING )?INDEX .*)?$");
+	int scans = 0;
+	for (const auto& plan : _dba.explainQueryPlans())
+	{
+		// listing a whole table has to read all of it anyway
+		if (plan.first.find(" WHERE ") == std::string::npos)
+		{
+			continue;
+		}
+
+		std::set<std::string> names;
+		for (std::sregex_iterator it(plan.first.begin(), plan.first.end(), tableName), end; it != end; ++it)
+		{
+			names.insert((*it)[1]);
+			names.insert((*it)[2]);
+		}
+
+		for (const auto& detail : plan.second)
+		{
+			std::smatch match;
+			if (std::regex_match(detail, match, fullScan) && names.count(match[1]) > 0)
+			{
+				std::cerr << "FAILED! " << detail << " in: " << plan.first << std::endl;
+				scans++;
+			}
+		}
+	}
+	if (scans == 0)
+	{
+		std::cout << "SUCCESS!" << std::endl;
+	}
+}
+
+void DataAccessTest::cacheHitRate()
+{
+	std::cout << "Repeating lookups through the cache:" << std::endl;
+	try
+	{
+		CachingDataAccess cache(_dba);
+		const int albumId = cache.findAlbumId("album1", 1);
+		for (int i = 0; i < 10; i++)
+		{
+			cache.getUser(1);
+			cache.openAlbum(albumId);
+		}
+		// the first lookup of each misses, the other 9 hit
+		const CachingDataAccess::CacheStatistics statistics = cache.getCacheStatistics();
+		if (statistics.hits == 18 && statistics.misses == 2)
+		{
+			std::cout << "SUCCESS!" << std::endl;
+		}
+		else
+		{
+			std::cerr << "FAILED! " << statistics.hits << " hits and " << statistics.misses << " misses, expected 18 and 2" << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "FAILED! Error - " << e.what() << std::endl;
+	}
+}
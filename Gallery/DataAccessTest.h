@@ -13,9 +13,11 @@ public:
 	void addRows();
 	void updateRows();
 	void removeRows();
+	void queryPlans();
+	void cacheHitRate();
 
 private:
-	static constexpr char* _dbFileName = "testDB.sqlite";
+	static constexpr const char* _dbFileName = ":memory:"; // a fresh database on every run, nothing is left on disk
 	DatabaseAccess _dba;
 };
 
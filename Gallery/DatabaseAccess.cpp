@@ -1,70 +1,345 @@
 #include "DatabaseAccess.h"
 #include "Constants.h"
 
-#include "io.h"
+#include <cstring>
 #include <vector>
 #include <algorithm>
 
 #include "AlbumNotOpenException.h"
 #include "ItemNotFoundException.h"
 #include "SQLException.h"
+#include "SearchTokens.h"
+#include "WriteBatch.h"
+
+// SCHEMA_MIGRATIONS[i] upgrades a database from schema version i to i + 1.
+// Only ever append to this list - existing files are upgraded in place on open().
+static const char* const SCHEMA_MIGRATIONS[] = {
+	// 1 - base tables
+	"CREATE TABLE IF NOT EXISTS Users(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,NAME TEXT NOT NULL);"\
+	"CREATE TABLE IF NOT EXISTS Albums(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,NAME TEXT NOT NULL,CREATION_DATE TEXT NOT NULL,USER_ID INTEGER NOT NULL,FOREIGN KEY(USER_ID) REFERENCES Users(ID) ON DELETE CASCADE);"\
+	"CREATE TABLE IF NOT EXISTS Pictures(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,NAME TEXT NOT NULL,LOCATION TEXT NOT NULL,CREATION_DATE TEXT NOT NULL,ALBUM_ID INTEGER NOT NULL,FOREIGN KEY(ALBUM_ID) REFERENCES Albums(ID) ON DELETE CASCADE);"\
+	"CREATE TABLE IF NOT EXISTS Tags(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,PICTURE_ID INTEGER NOT NULL,USER_ID INTEGER NOT NULL,FOREIGN KEY(PICTURE_ID) REFERENCES Pictures(ID) ON DELETE CASCADE,FOREIGN KEY(USER_ID) REFERENCES Users(ID) ON DELETE CASCADE);",
+	// 2 - indexes for album lookups by name/owner, the album->pictures->tags joins,
+	// per user tag counts and the ON DELETE CASCADE child lookups
+	"CREATE INDEX IF NOT EXISTS Albums_NAME_USER_ID ON Albums(NAME, USER_ID);"\
+	"CREATE INDEX IF NOT EXISTS Albums_USER_ID ON Albums(USER_ID);"\
+	"CREATE INDEX IF NOT EXISTS Pictures_ALBUM_ID_NAME ON Pictures(ALBUM_ID, NAME);"\
+	"CREATE INDEX IF NOT EXISTS Tags_PICTURE_ID_USER_ID ON Tags(PICTURE_ID, USER_ID);"\
+	"CREATE INDEX IF NOT EXISTS Tags_USER_ID_PICTURE_ID ON Tags(USER_ID, PICTURE_ID);",
+	// 3 - tag counters on users and pictures, kept exact by triggers on Tags, for the top tagged queries.
+	// the UPDATEs rebuild the counters of databases that already have tags
+	"ALTER TABLE Users ADD COLUMN TAG_COUNT INTEGER NOT NULL DEFAULT 0;"\
+	"ALTER TABLE Pictures ADD COLUMN TAG_COUNT INTEGER NOT NULL DEFAULT 0;"\
+	"UPDATE Users SET TAG_COUNT=(SELECT COUNT(1) FROM Tags WHERE USER_ID=Users.ID);"\
+	"UPDATE Pictures SET TAG_COUNT=(SELECT COUNT(1) FROM Tags WHERE PICTURE_ID=Pictures.ID);"\
+	"CREATE INDEX IF NOT EXISTS Users_TAG_COUNT ON Users(TAG_COUNT);"\
+	"CREATE INDEX IF NOT EXISTS Pictures_TAG_COUNT ON Pictures(TAG_COUNT);"\
+	"CREATE TRIGGER IF NOT EXISTS Tags_count_insert AFTER INSERT ON Tags BEGIN "\
+		"UPDATE Users SET TAG_COUNT=TAG_COUNT+1 WHERE ID=NEW.USER_ID;"\
+		"UPDATE Pictures SET TAG_COUNT=TAG_COUNT+1 WHERE ID=NEW.PICTURE_ID; END;"\
+	"CREATE TRIGGER IF NOT EXISTS Tags_count_delete AFTER DELETE ON Tags BEGIN "\
+		"UPDATE Users SET TAG_COUNT=TAG_COUNT-1 WHERE ID=OLD.USER_ID;"\
+		"UPDATE Pictures SET TAG_COUNT=TAG_COUNT-1 WHERE ID=OLD.PICTURE_ID; END;"\
+	"CREATE TRIGGER IF NOT EXISTS Tags_count_update AFTER UPDATE OF PICTURE_ID, USER_ID ON Tags BEGIN "\
+		"UPDATE Users SET TAG_COUNT=TAG_COUNT-1 WHERE ID=OLD.USER_ID;"\
+		"UPDATE Pictures SET TAG_COUNT=TAG_COUNT-1 WHERE ID=OLD.PICTURE_ID;"\
+		"UPDATE Users SET TAG_COUNT=TAG_COUNT+1 WHERE ID=NEW.USER_ID;"\
+		"UPDATE Pictures SET TAG_COUNT=TAG_COUNT+1 WHERE ID=NEW.PICTURE_ID; END;",
+	// 4 - pictures of an album in id order, for paging through an album
+	"CREATE INDEX IF NOT EXISTS Pictures_ALBUM_ID_ID ON Pictures(ALBUM_ID, ID);",
+	// 5 - full text index of picture names, paths and album names, keyed by picture id and kept in sync
+	// by triggers. pictures of a deleted album leave through the ON DELETE CASCADE of Pictures
+	"CREATE VIRTUAL TABLE IF NOT EXISTS PictureSearch USING fts5(NAME, LOCATION, ALBUM_NAME, prefix='2 3');"\
+	"INSERT INTO PictureSearch(rowid, NAME, LOCATION, ALBUM_NAME) SELECT p.ID, p.NAME, p.LOCATION, a.NAME FROM Pictures p JOIN Albums a ON a.ID=p.ALBUM_ID;"\
+	"CREATE TRIGGER IF NOT EXISTS Pictures_search_insert AFTER INSERT ON Pictures BEGIN "\
+		"INSERT INTO PictureSearch(rowid, NAME, LOCATION, ALBUM_NAME) SELECT NEW.ID, NEW.NAME, NEW.LOCATION, NAME FROM Albums WHERE ID=NEW.ALBUM_ID; END;"\
+	"CREATE TRIGGER IF NOT EXISTS Pictures_search_delete AFTER DELETE ON Pictures BEGIN "\
+		"DELETE FROM PictureSearch WHERE rowid=OLD.ID; END;"\
+	"CREATE TRIGGER IF NOT EXISTS Pictures_search_update AFTER UPDATE OF NAME, LOCATION, ALBUM_ID ON Pictures BEGIN "\
+		"UPDATE PictureSearch SET NAME=NEW.NAME, LOCATION=NEW.LOCATION, ALBUM_NAME=(SELECT NAME FROM Albums WHERE ID=NEW.ALBUM_ID) WHERE rowid=NEW.ID; END;"\
+	"CREATE TRIGGER IF NOT EXISTS Albums_search_update AFTER UPDATE OF NAME ON Albums BEGIN "\
+		"UPDATE PictureSearch SET ALBUM_NAME=NEW.NAME WHERE rowid IN (SELECT ID FROM Pictures WHERE ALBUM_ID=NEW.ID); END;",
+	// 6 - creation dates as seconds since the epoch instead of local "dd/mm/yyyy hh:mm:ss" text, which doesn't sort.
+	// existing dates are converted from local time, ones that don't parse become 0
+	"ALTER TABLE Albums ADD COLUMN CREATION_TIME INTEGER NOT NULL DEFAULT 0;"\
+	"ALTER TABLE Pictures ADD COLUMN CREATION_TIME INTEGER NOT NULL DEFAULT 0;"\
+	"UPDATE Albums SET CREATION_TIME=IFNULL(CAST(strftime('%s', substr(CREATION_DATE, 7, 4) || '-' || substr(CREATION_DATE, 4, 2)"\
+		" || '-' || substr(CREATION_DATE, 1, 2) || ' ' || substr(CREATION_DATE, 12), 'utc') AS INTEGER), 0);"\
+	"UPDATE Pictures SET CREATION_TIME=IFNULL(CAST(strftime('%s', substr(CREATION_DATE, 7, 4) || '-' || substr(CREATION_DATE, 4, 2)"\
+		" || '-' || substr(CREATION_DATE, 1, 2) || ' ' || substr(CREATION_DATE, 12), 'utc') AS INTEGER), 0);"\
+	"ALTER TABLE Albums DROP COLUMN CREATION_DATE;"\
+	"ALTER TABLE Pictures DROP COLUMN CREATION_DATE;"\
+	"CREATE INDEX IF NOT EXISTS Pictures_CREATION_TIME ON Pictures(CREATION_TIME);"\
+	"CREATE INDEX IF NOT EXISTS Pictures_ALBUM_ID_CREATION_TIME ON Pictures(ALBUM_ID, CREATION_TIME);",
+};
+static const int SCHEMA_VERSION = sizeof(SCHEMA_MIGRATIONS) / sizeof(SCHEMA_MIGRATIONS[0]);
+
+// rows per multi-row INSERT when bulk loading. every chunk takes the largest size that fits in the
+// rows left, so any count is written in a few statements from a small set of cached ones
+static const int BULK_INSERT_STEPS[] = { 64, 16, 4, 1 };
+static const int BULK_INSERT_STEP_COUNT = sizeof(BULK_INSERT_STEPS) / sizeof(BULK_INSERT_STEPS[0]);
+
+// index of the largest step that fits in remaining rows
+static int bulkInsertStep(size_t remaining)
+{
+	int step = 0;
+	while ((size_t)BULK_INSERT_STEPS[step] > remaining)
+	{
+		step++;
+	}
+	return step;
+}
+
+// "<insert> <row>, <row>, ... <row>;" with rowCount placeholder rows
+static std::string buildMultiRowInsert(const std::string& insert, const std::string& row, int rowCount)
+{
+	std::string sql = insert;
+	for (int i = 0; i < rowCount; i++)
+	{
+		sql += (i == 0 ? " " : ", ") + row;
+	}
+	return sql + ';';
+}
+
+// one multi-row insert per step of the ladder
+static std::vector<std::string> buildBulkInserts(const std::string& insert, const std::string& row)
+{
+	std::vector<std::string> inserts;
+	for (int step = 0; step < BULK_INSERT_STEP_COUNT; step++)
+	{
+		inserts.push_back(buildMultiRowInsert(insert, row, BULK_INSERT_STEPS[step]));
+	}
+	return inserts;
+}
 
 DatabaseAccess::DatabaseAccess()
-	: _db(nullptr), _dbFileName("galleryDB.sqlite")
+	: DatabaseAccess("galleryDB.sqlite")
 {
 }
 
 DatabaseAccess::DatabaseAccess(const char* DBFileName)
-	: _db(nullptr), _dbFileName(DBFileName)
+	: DatabaseAccess(DBFileName, DatabaseOptions())
+{
+}
+
+DatabaseAccess::DatabaseAccess(const char* DBFileName, const DatabaseOptions& options)
+	: _dbFileName(DBFileName), _db(nullptr), _options(options),
+	_dataVersion(0), _lastExternalVersion(-1), _lastLocalChanges(-1)
 {
 }
 
+DatabaseAccess::~DatabaseAccess()
+{
+	close();
+}
+
 User DatabaseAccess::getTopTaggedUser()
 {
-	User user(0, "");
-	auto sql = "SELECT Users.ID ID, Users.NAME NAME FROM Tags JOIN Users on USER_ID=Users.ID GROUP BY Users.ID ORDER BY COUNT(1) DESC LIMIT 1;";
-	execQuery(sql, singleUserDBCallback, &user);
-	return user;
+	auto top = getTopTaggedUsers(1);
+	return top.empty() ? User(0, "") : top.front();
 }
 
 Picture DatabaseAccess::getTopTaggedPicture()
 {
-	Picture p(0, "");
-	auto sql = "SELECT * FROM Tags JOIN Pictures ON Pictures.ID=PICTURE_ID WHERE PICTURE_ID=(SELECT PICTURE_ID FROM Tags GROUP BY PICTURE_ID ORDER BY COUNT(1) DESC LIMIT 1);";
-	execQuery(sql, singlePictureDBCallback, &p);
-	return p;
+	auto top = getTopTaggedPictures(1);
+	return top.empty() ? Picture(0, "") : top.front();
+}
+
+std::list<User> DatabaseAccess::getTopTaggedUsers(int count)
+{
+	auto stmt = prepareStatement("SELECT ID, NAME FROM Users WHERE TAG_COUNT > 0 ORDER BY TAG_COUNT DESC LIMIT ?;", count);
+	return queryList<User>(stmt);
+}
+
+std::list<Picture> DatabaseAccess::getTopTaggedPictures(int count)
+{
+	auto stmt = prepareStatement("SELECT ID, NAME, LOCATION, CREATION_TIME FROM Pictures WHERE TAG_COUNT > 0 ORDER BY TAG_COUNT DESC LIMIT ?;", count);
+	std::list<Picture> pictures = queryList<Picture>(stmt);
+	readTags(pictures);
+	return pictures;
 }
 
 std::list<Picture> DatabaseAccess::getTaggedPicturesOfUser(const User& user)
 {
-	const auto& sql = "SELECT * FROM Pictures JOIN Tags ON Pictures.ID=PICTURE_ID WHERE Tags.USER_ID=" + std::to_string(user.getId()) + ';';
 	std::list<Picture> ans;
-	execQuery(sql.c_str(), pictureListDBCallback, &ans);
+	forEachTaggedPictureOfUser(user, [&](const Picture& picture) { ans.push_back(picture); });
 	return ans;
 }
 
+std::list<Picture> DatabaseAccess::searchPictures(const std::string& query, int limit)
+{
+	// every word becomes a quoted prefix term, so nothing the user types is read as FTS5 syntax
+	std::string match;
+	for (const auto& token : splitSearchTokens(query))
+	{
+		match += (match.empty() ? "\"" : " \"") + token + "\"*";
+	}
+	if (match.empty())
+	{
+		return std::list<Picture>();
+	}
+
+	auto stmt = prepareStatement("SELECT p.ID, p.NAME, p.LOCATION, p.CREATION_TIME FROM PictureSearch s"\
+		" JOIN Pictures p ON p.ID=s.rowid WHERE PictureSearch MATCH ? ORDER BY s.rank LIMIT ?;", match, limit);
+	std::list<Picture> pictures = queryList<Picture>(stmt);
+	readTags(pictures);
+	return pictures;
+}
+
+void DatabaseAccess::beginBatch()
+{
+	// a savepoint opens a transaction when there is none and nests inside one otherwise
+	execStatement("SAVEPOINT batch;");
+}
+
+void DatabaseAccess::commitBatch()
+{
+	execStatement("RELEASE batch;");
+}
+
+void DatabaseAccess::rollbackBatch()
+{
+	execStatement("ROLLBACK TO batch; RELEASE batch;");
+}
+
+long long DatabaseAccess::getDataVersion()
+{
+	// data_version only moves for commits of other connections, our own writes show up in total_changes
+	int externalVersion = countQuery(prepareStatement("PRAGMA data_version;"));
+	long long localChanges = sqlite3_total_changes64(_db);
+	if (externalVersion != _lastExternalVersion || localChanges != _lastLocalChanges)
+	{
+		_lastExternalVersion = externalVersion;
+		_lastLocalChanges = localChanges;
+		_dataVersion++;
+	}
+	return _dataVersion;
+}
+
+void DatabaseAccess::printQueryProfile(std::ostream& out)
+{
+	if (!_options.profileQueries)
+	{
+		out << "Query profiling is turned off for this database." << std::endl;
+		return;
+	}
+	_profiler.print(out);
+}
+
+std::map<std::string, std::list<std::string>> DatabaseAccess::explainQueryPlans()
+{
+	std::map<std::string, std::list<std::string>> plans;
+	for (const auto& entry : _statements)
+	{
+		plans[entry.first];
+	}
+
+	for (auto& plan : plans)
+	{
+		// not cached, these are one-off statements and _statements is being walked
+		sqlite3_stmt* stmt = nullptr;
+		const std::string sql = "EXPLAIN QUERY PLAN " + plan.first;
+		if (sqlite3_prepare_v2(_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+		{
+			throw SQLException(sqlite3_errmsg(_db));
+		}
+		try
+		{
+			// columns are id, parent, notused, detail
+			forEachRow(stmt, [&](sqlite3_stmt* row) { plan.second.push_back(column<std::string>(row, 3)); });
+		}
+		catch (...)
+		{
+			sqlite3_finalize(stmt);
+			throw;
+		}
+		sqlite3_finalize(stmt);
+	}
+	return plans;
+}
+
+void DatabaseAccess::startBackup(const std::string& path)
+{
+	if (_db == nullptr)
+	{
+		throw MyException("Database is not open\n");
+	}
+	_backup.start(_db, path);
+}
+
+BackupProgress DatabaseAccess::getBackupProgress()
+{
+	return _backup.getProgress();
+}
+
+MaintenanceReport DatabaseAccess::runMaintenance(bool allowFullVacuum)
+{
+	if (_db == nullptr)
+	{
+		throw MyException("Database is not open\n");
+	}
+
+	// optimize only analyzes the tables whose statistics are missing or stale, the limit keeps each ANALYZE small
+	execStatement("PRAGMA analysis_limit=1000;PRAGMA optimize;");
+
+	MaintenanceReport report;
+	report.freelistPages = countQuery(prepareStatement("PRAGMA freelist_count;"));
+	if (report.freelistPages == 0 || report.freelistPages < _options.vacuumFreelistPages)
+	{
+		return report;
+	}
+
+	const bool incremental = countQuery(prepareStatement("PRAGMA auto_vacuum;")) == 2;
+	if (!incremental && !allowFullVacuum)
+	{
+		return report;
+	}
+
+	const long long pageSize = countQuery(prepareStatement("PRAGMA page_size;"));
+	const int pagesBefore = countQuery(prepareStatement("PRAGMA page_count;"));
+	if (!incremental)
+	{
+		// a file from before incremental auto_vacuum needs one full VACUUM to switch over
+		execStatement("PRAGMA auto_vacuum=INCREMENTAL;VACUUM;");
+	}
+	else
+	{
+		execStatement("PRAGMA incremental_vacuum;");
+	}
+	report.vacuumed = true;
+	// switching over adds pointer map pages, which can outweigh what a small freelist gave back
+	report.bytesReclaimed = std::max(0LL, (pagesBefore - countQuery(prepareStatement("PRAGMA page_count;"))) * pageSize);
+	return report;
+}
+
 bool DatabaseAccess::open()
 {
-	bool fileExists = _access(_dbFileName, 0) == 0;
-	int res = sqlite3_open(_dbFileName, &_db);
+	const char* name = isInMemory() ? _options.memoryDatabase : _dbFileName;
+	int res = sqlite3_open_v2(name, &_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, nullptr);
 	if (res != SQLITE_OK) {
+		sqlite3_close(_db);
 		_db = nullptr;
 		throw SQLException("Error opening database");
 	}
-	if (!fileExists)
+	try
 	{
-		try
+		if (isInMemory())
 		{
-			createDatabase(); // will run "PRAGMA foreign_keys=ON" aswell
+			loadSnapshot();
 		}
-		catch (const SQLException& e)
+		if (_options.profileQueries)
 		{
-			std::cerr << "Error creating database: " << e.what() << std::endl;
+			_profiler.attach(_db);
 		}
+		execStatement("PRAGMA foreign_keys=ON;"); // needs to be run for ON DELETE CASCADE to work
+		applyOptions();
+		migrateDatabase(); // creates the schema on a new file, upgrades it on an old one
 	}
-	else
+	catch (const SQLException&)
 	{
-		execStatement("PRAGMA foreign_keys=ON;"); // needs to be run for ON DELETE CASCADE to work
+		// every query expects the latest schema, so a file that couldn't be upgraded is not opened
+		closeConnection();
+		throw;
 	}
 	return true;
 }
@@ -73,234 +348,516 @@ void DatabaseAccess::close()
 {
 	if (_db != nullptr)
 	{
-		sqlite3_close(_db);
-		_db = nullptr;
+		try
+		{
+			if (_options.maintainOnClose)
+			{
+				runMaintenance(false); // never a full VACUUM on the way out, that is up to the maintenance command
+			}
+		}
+		catch (const std::exception& e)
+		{
+			std::cerr << "Error maintaining database: " << e.what() << std::endl;
+		}
+		try
+		{
+			saveSnapshot();
+		}
+		catch (const SQLException& e)
+		{
+			std::cerr << "Error saving database: " << e.what() << std::endl;
+		}
+		_backup.cancel(); // it reads from the connection
+		closeConnection();
 	}
 }
 
+void DatabaseAccess::closeConnection()
+{
+	finalizeStatements(); // sqlite3_close fails while statements are still alive
+	_profiler.detach(_db);
+	sqlite3_close(_db);
+	_db = nullptr;
+}
+
 void DatabaseAccess::clear()
 {
 }
 
-void DatabaseAccess::execStatement(const char* sqlStatement) const
+void DatabaseAccess::saveSnapshot()
 {
-	char* errmsg = nullptr;
-	if (sqlite3_exec(_db, sqlStatement, nullptr, nullptr, &errmsg) != SQLITE_OK)
+	if (!isInMemory())
 	{
-		throw SQLException(errmsg);
+		return;
 	}
+
+	sqlite3* file = nullptr;
+	if (sqlite3_open(_dbFileName, &file) != SQLITE_OK)
+	{
+		const std::string error = sqlite3_errmsg(file);
+		sqlite3_close(file);
+		throw SQLException(error);
+	}
+	sqlite3_busy_timeout(file, _options.busyTimeoutMs);
+	try
+	{
+		copyDatabase(_db, file);
+	}
+	catch (...)
+	{
+		sqlite3_close(file);
+		throw;
+	}
+	sqlite3_close(file);
 }
 
-void DatabaseAccess::execQuery(const char* sqlStatement, int(*callback)(void*, int, char**, char**), void* callbackData) const
+bool DatabaseAccess::isInMemory() const
 {
-	char* errmsg = nullptr;
-	if (sqlite3_exec(_db, sqlStatement, callback, callbackData, &errmsg) != SQLITE_OK)
+	// a file that is itself in memory has nowhere to be saved to
+	return _options.memoryDatabase != nullptr && std::strcmp(_dbFileName, ":memory:") != 0;
+}
+
+void DatabaseAccess::loadSnapshot()
+{
+	sqlite3* file = nullptr;
+	if (sqlite3_open_v2(_dbFileName, &file, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK)
 	{
-		throw SQLException(errmsg);
+		// no file yet, the schema is created in memory and the file is written on save
+		sqlite3_close(file);
+		return;
+	}
+	sqlite3_busy_timeout(file, _options.busyTimeoutMs);
+	try
+	{
+		copyDatabase(file, _db);
+	}
+	catch (...)
+	{
+		sqlite3_close(file);
+		throw;
 	}
+	sqlite3_close(file);
 }
 
-void DatabaseAccess::createDatabase() const
+void DatabaseAccess::copyDatabase(sqlite3* from, sqlite3* to)
 {
-	auto createQuery = "CREATE TABLE Users(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,NAME TEXT NOT NULL);"\
-		"CREATE TABLE Albums(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,NAME TEXT NOT NULL,CREATION_DATE TEXT NOT NULL,USER_ID INTEGER NOT NULL,FOREIGN KEY(USER_ID) REFERENCES Users(ID) ON DELETE CASCADE);"\
-		"CREATE TABLE Pictures(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,NAME TEXT NOT NULL,LOCATION TEXT NOT NULL,CREATION_DATE TEXT NOT NULL,ALBUM_ID INTEGER NOT NULL,FOREIGN KEY(ALBUM_ID) REFERENCES Albums(ID) ON DELETE CASCADE);"\
-		"CREATE TABLE Tags(ID INTEGER PRIMARY KEY AUTOINCREMENT NOT NULL,PICTURE_ID INTEGER NOT NULL,USER_ID INTEGER NOT NULL,FOREIGN KEY(PICTURE_ID) REFERENCES Pictures(ID) ON DELETE CASCADE,FOREIGN KEY(USER_ID) REFERENCES Users(ID) ON DELETE CASCADE);"\
-		"PRAGMA	foreign_keys=ON;";
-	execStatement(createQuery);
+	sqlite3_backup* backup = sqlite3_backup_init(to, "main", from, "main");
+	if (backup == nullptr)
+	{
+		throw SQLException(sqlite3_errmsg(to));
+	}
+	int res = sqlite3_backup_step(backup, -1); // all pages in one step, the copy is consistent
+	sqlite3_backup_finish(backup);
+	if (res != SQLITE_DONE)
+	{
+		throw SQLException(sqlite3_errstr(res));
+	}
 }
 
-int DatabaseAccess::countQuery(const char* sql) const
+void DatabaseAccess::execStatement(const char* sqlStatement) const
 {
-	int count;
-	execQuery(sql, singleIntDBCallback, &count);
-	return count;
+	char* errmsg = nullptr;
+	if (sqlite3_exec(_db, sqlStatement, nullptr, nullptr, &errmsg) != SQLITE_OK)
+	{
+		throw SQLException(errmsg);
+	}
 }
 
-int DatabaseAccess::albumListDBCallback(void* albumList, int argc, char** argv, char** azColName)
+void DatabaseAccess::applyOptions()
 {
-	Album album;
-	singleAlbumDBCallback(&album, argc, argv, azColName);
-	((std::list<Album>*)albumList)->push_back(album);
-	return 0;
+	sqlite3_busy_timeout(_db, _options.busyTimeoutMs);
+
+	// auto_vacuum only takes on a new file, before journal_mode=WAL writes its header, so it is set
+	// once there. older files are switched over by the one full VACUUM of runMaintenance(true)
+	if (countQuery(prepareStatement("PRAGMA page_count;")) == 0)
+	{
+		execStatement("PRAGMA auto_vacuum=INCREMENTAL;");
+	}
+
+	// pragma values can't be bound as parameters, they are all numbers so building the string is safe
+	std::string pragmas = std::string("PRAGMA journal_mode=") + (_options.walJournal ? "WAL" : "DELETE") + ';'
+		+ "PRAGMA synchronous=" + std::to_string(_options.synchronous) + ';'
+		+ "PRAGMA mmap_size=" + std::to_string(_options.mmapSize) + ';'
+		+ "PRAGMA cache_size=-" + std::to_string(_options.cacheSizeKb) + ';' // negative means KiB instead of pages
+		+ "PRAGMA temp_store=" + std::to_string(_options.tempStore) + ';';
+	execStatement(pragmas.c_str());
 }
 
-int DatabaseAccess::singleAlbumDBCallback(void* outAlbum, int argc, char** argv, char** azColName)
+void DatabaseAccess::migrateDatabase()
 {
-	Album* album = (Album*)outAlbum;
-	Picture currPic(0, "");
-	for (int i = 0; i < argc; i++)
-	{
-		if (argv[i] == NULL) // null string
-		{
-			continue; // column is empty
-		}
+	execStatement("CREATE TABLE IF NOT EXISTS schema_version(VERSION INTEGER NOT NULL);");
+	int version = countQuery(prepareStatement("SELECT IFNULL(MAX(VERSION), 0) FROM schema_version;"));
 
-		const std::string& col = azColName[i];
-		if (col == "ANAME")
-		{
-			album->setName(argv[i]);
-		}
-		else if (col == "ACD")
-		{
-			album->setCreationDate(argv[i]);
-		}
-		else if (col == "AUID")
-		{
-			album->setOwner(std::stoi(argv[i]));
-		}
-		else if (col == "PNAME")
-		{
-			currPic.setName(argv[i]);
-		}
-		else if (col == "PLOC")
+	// every step runs in its own transaction so a failed upgrade leaves the previous version intact
+	for (; version < SCHEMA_VERSION; version++)
+	{
+		execStatement("BEGIN;");
+		try
 		{
-			currPic.setPath(argv[i]);
+			execStatement(SCHEMA_MIGRATIONS[version]);
+			execPrepared(prepareStatement("DELETE FROM schema_version;"));
+			execPrepared(prepareStatement("INSERT INTO schema_version(VERSION) VALUES (?);", version + 1));
+			execStatement("COMMIT;");
 		}
-		else if (col == "PCD")
+		catch (const SQLException&)
 		{
-			currPic.setCreationDate(argv[i]);
+			sqlite3_exec(_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+			throw;
 		}
-		else if (col == "TUID")
+	}
+}
+
+sqlite3_stmt* DatabaseAccess::getStatement(const char* sql)
+{
+	auto it = _statements.find(sql);
+	if (it != _statements.end())
+	{
+		if (sqlite3_stmt_busy(it->second))
 		{
-			currPic.tagUser(std::stoi(argv[i]));
+			// resetting it would silently cut short a forEach* that is still reading from it
+			throw SQLException(std::string("Query is already running: ") + sql);
 		}
+		sqlite3_reset(it->second);
+		sqlite3_clear_bindings(it->second);
+		return it->second;
 	}
-	if (album->doesPictureExists(currPic.getName()))
+
+	sqlite3_stmt* stmt = nullptr;
+	if (sqlite3_prepare_v3(_db, sql, -1, SQLITE_PREPARE_PERSISTENT, &stmt, nullptr) != SQLITE_OK)
 	{
-		// theres only one picture in currPic since were only looking at a single column
-		album->tagUserInPicture(*currPic.getUserTags().begin(), currPic.getName());
+		throw SQLException(sqlite3_errmsg(_db));
 	}
-	else
+	_statements.emplace(sql, stmt);
+	return stmt;
+}
+
+void DatabaseAccess::finalizeStatements()
+{
+	for (auto& entry : _statements)
 	{
-		album->addPicture(currPic);
+		sqlite3_finalize(entry.second);
 	}
-	return 0;
+	_statements.clear();
 }
 
-int DatabaseAccess::singleFloatDBCallback(void* out, int argc, char** argv, char** azColName)
+void DatabaseAccess::bindParams(sqlite3_stmt*, int)
 {
-	*((float*)out) = std::stof(argv[0]);
-	return 0;
+	// end of the parameter pack, nothing left to bind
 }
 
-int DatabaseAccess::singleIntDBCallback(void* out, int argc, char** argv, char** azColName)
+void DatabaseAccess::bindParam(sqlite3_stmt* stmt, int index, int value)
 {
-	*((int*)out) = std::stoi(argv[0]);
-	return 0;
+	sqlite3_bind_int(stmt, index, value);
 }
 
-int DatabaseAccess::printUserDBCallback(void*, int argc, char** argv, char** azColName)
+void DatabaseAccess::bindParam(sqlite3_stmt* stmt, int index, long long value)
 {
-	User user(0, "");
-	singleUserDBCallback(&user, argc, argv, azColName);
-	std::cout << user << std::endl;
-	return 0;
+	sqlite3_bind_int64(stmt, index, value);
 }
 
-int DatabaseAccess::singleUserDBCallback(void* outUser, int argc, char** argv, char** azColName)
+void DatabaseAccess::bindParam(sqlite3_stmt* stmt, int index, const std::string& value)
 {
-	User* user = (User*)outUser;
-	for (int i = 0; i < argc; i++)
+	sqlite3_bind_text(stmt, index, value.c_str(), (int)value.size(), SQLITE_TRANSIENT);
+}
+
+void DatabaseAccess::execPrepared(sqlite3_stmt* stmt) const
+{
+	forEachRow(stmt, [](sqlite3_stmt*) {});
+}
+
+int DatabaseAccess::countQuery(sqlite3_stmt* stmt) const
+{
+	int count = 0;
+	forEachRow(stmt, [&](sqlite3_stmt* row) { count = column<int>(row, 0); });
+	return count;
+}
+
+void DatabaseAccess::readTags(std::list<Picture>& pictures)
+{
+	// one tag query for the whole result set: the ids travel as a single json array parameter
+	// so the statement text (and its cached plan) is the same whatever the number of pictures
+	if (pictures.empty())
 	{
-		const std::string& col = azColName[i];
-		if (col == "NAME")
-		{
-			user->setName(argv[i]);
-		}
-		else if (col == "ID")
+		return;
+	}
+	std::string pictureIds;
+	std::unordered_map<int, Picture*> pictureById;
+	for (auto& picture : pictures)
+	{
+		pictureIds += (pictureIds.empty() ? "[" : ",") + std::to_string(picture.getId());
+		pictureById.emplace(picture.getId(), &picture);
+	}
+	pictureIds += "]";
+
+	auto stmt = prepareStatement("SELECT PICTURE_ID, USER_ID FROM Tags WHERE PICTURE_ID IN (SELECT value FROM json_each(?));", pictureIds);
+	forEachRow(stmt, [&](sqlite3_stmt* row) {
+		auto it = pictureById.find(column<int>(row, 0));
+		if (it != pictureById.end())
 		{
-			user->setId(std::stoi(argv[i]));
+			it->second->tagUser(column<int>(row, 1));
 		}
-	}
-	return 0;
+	});
+}
+
+template <>
+int DatabaseAccess::column<int>(sqlite3_stmt* stmt, int index)
+{
+	return sqlite3_column_int(stmt, index); // NULL reads as 0
 }
 
-int DatabaseAccess::singlePictureDBCallback(void* outPicture, int argc, char** argv, char** azColName)
+template <>
+long long DatabaseAccess::column<long long>(sqlite3_stmt* stmt, int index)
 {
-	Picture* pic = (Picture*)outPicture;
-	for (int i = 0; i < argc; i++)
+	return sqlite3_column_int64(stmt, index);
+}
+
+template <>
+float DatabaseAccess::column<float>(sqlite3_stmt* stmt, int index)
+{
+	return (float)sqlite3_column_double(stmt, index); // NULL reads as 0
+}
+
+template <>
+std::string DatabaseAccess::column<std::string>(sqlite3_stmt* stmt, int index)
+{
+	auto text = (const char*)sqlite3_column_text(stmt, index);
+	if (text == nullptr)
 	{
-		const std::string& col = azColName[i];
-		if (col == "NAME")
-		{
-			pic->setName(argv[i]);
-		}
-		else if (col == "ID")
-		{
-			pic->setId(std::stoi(argv[i]));
-		}
-		else if (col == "CREATION_DATE")
-		{
-			pic->setCreationDate(argv[i]);
-		}
-		else if (col == "LOCATION")
-		{
-			pic->setPath(argv[i]);
-		}
-		else if (col == "USER_ID")
-		{
-			pic->tagUser(std::stoi(argv[i]));
-		}
+		return "";
 	}
-	return 0;
+	return std::string(text, sqlite3_column_bytes(stmt, index));
+}
+
+template <>
+User DatabaseAccess::readRow<User>(sqlite3_stmt* stmt, int firstColumn)
+{
+	return User(column<int>(stmt, firstColumn), column<std::string>(stmt, firstColumn + 1));
+}
+
+template <>
+Album DatabaseAccess::readRow<Album>(sqlite3_stmt* stmt, int firstColumn)
+{
+	Album album(column<int>(stmt, firstColumn + 2), column<std::string>(stmt, firstColumn),
+		column<long long>(stmt, firstColumn + 1));
+	album.setId(column<int>(stmt, firstColumn + 3));
+	return album;
 }
 
-int DatabaseAccess::pictureListDBCallback(void* pictureList, int argc, char** argv, char** azColName)
+template <>
+Picture DatabaseAccess::readRow<Picture>(sqlite3_stmt* stmt, int firstColumn)
 {
-	Picture p(0, "");
-	singlePictureDBCallback(&p, argc, argv, azColName);
-	((std::list<Picture>*) pictureList)->push_back(p);
-	return 0;
+	return Picture(column<int>(stmt, firstColumn), column<std::string>(stmt, firstColumn + 1),
+		column<std::string>(stmt, firstColumn + 2), column<long long>(stmt, firstColumn + 3));
 }
 
-const std::list<Album> DatabaseAccess::getAlbums()
+std::list<Album> DatabaseAccess::getAlbums()
 {
-	auto sql = "SELECT NAME ANAME, CREATION_DATE ACD, USER_ID AUID FROM Albums;";
 	std::list<Album> ans;
-	execQuery(sql, albumListDBCallback, &ans);
+	forEachAlbum([&](const Album& album) { ans.push_back(album); });
 	return ans;
 }
 
-const std::list<Album> DatabaseAccess::getAlbumsOfUser(const User& user)
+std::list<Album> DatabaseAccess::getAlbumsOfUser(const User& user)
 {
-	const auto& sql = "SELECT NAME ANAME, CREATION_DATE ACD, USER_ID AUID FROM Albums WHERE AUID=" + std::to_string(user.getId()) + ';';
 	std::list<Album> ans;
-	execQuery(sql.c_str(), albumListDBCallback, &ans);
+	forEachAlbumOfUser(user, [&](const Album& album) { ans.push_back(album); });
 	return ans;
 }
 
+void DatabaseAccess::forEachAlbum(const std::function<void(const Album&)>& visit)
+{
+	auto stmt = prepareStatement("SELECT NAME, CREATION_TIME, USER_ID, ID FROM Albums;");
+	forEachRow(stmt, [&](sqlite3_stmt* row) { visit(readRow<Album>(row)); });
+}
+
+void DatabaseAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit)
+{
+	auto stmt = prepareStatement("SELECT NAME, CREATION_TIME, USER_ID, ID FROM Albums WHERE USER_ID=?;", user.getId());
+	forEachRow(stmt, [&](sqlite3_stmt* row) { visit(readRow<Album>(row)); });
+}
+
+void DatabaseAccess::forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit)
+{
+	auto stmt = prepareStatement("SELECT Pictures.ID, NAME, LOCATION, CREATION_TIME FROM Pictures JOIN Tags ON Pictures.ID=PICTURE_ID WHERE Tags.USER_ID=?;", user.getId());
+	forEachRow(stmt, [&](sqlite3_stmt* row) {
+		Picture picture = readRow<Picture>(row);
+		picture.tagUser(user.getId());
+		visit(picture);
+	});
+}
+
+std::list<Album> DatabaseAccess::getAlbums(int afterId, int limit)
+{
+	auto stmt = prepareStatement("SELECT NAME, CREATION_TIME, USER_ID, ID FROM Albums WHERE ID > ? ORDER BY ID LIMIT ?;", afterId, limit);
+	return queryList<Album>(stmt);
+}
+
+std::list<User> DatabaseAccess::getUsers(int afterId, int limit)
+{
+	auto stmt = prepareStatement("SELECT ID, NAME FROM Users WHERE ID > ? ORDER BY ID LIMIT ?;", afterId, limit);
+	return queryList<User>(stmt);
+}
+
+std::list<Picture> DatabaseAccess::getPicturesOfAlbum(int albumId, int afterId, int limit)
+{
+	auto stmt = prepareStatement("SELECT ID, NAME, LOCATION, CREATION_TIME FROM Pictures "\
+		"WHERE ALBUM_ID=? AND ID > ? ORDER BY ID LIMIT ?;", albumId, afterId, limit);
+	std::list<Picture> pictures = queryList<Picture>(stmt);
+	readTags(pictures);
+	return pictures;
+}
+
+std::list<Picture> DatabaseAccess::getPicturesCreatedBetween(long long from, long long to)
+{
+	auto stmt = prepareStatement("SELECT ID, NAME, LOCATION, CREATION_TIME FROM Pictures "\
+		"WHERE CREATION_TIME BETWEEN ? AND ? ORDER BY CREATION_TIME;", from, to);
+	std::list<Picture> pictures = queryList<Picture>(stmt);
+	readTags(pictures);
+	return pictures;
+}
+
+std::list<Picture> DatabaseAccess::getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to)
+{
+	auto stmt = prepareStatement("SELECT ID, NAME, LOCATION, CREATION_TIME FROM Pictures "\
+		"WHERE ALBUM_ID=? AND CREATION_TIME BETWEEN ? AND ? ORDER BY CREATION_TIME;", albumId, from, to);
+	std::list<Picture> pictures = queryList<Picture>(stmt);
+	readTags(pictures);
+	return pictures;
+}
+
 void DatabaseAccess::createAlbum(const Album& album)
 {
-	auto sql = "INSERT INTO Albums(NAME, CREATION_DATE, USER_ID) VALUES (\"" + album.getName()
-		+ "\", \"" + album.getCreationDate() + "\", " + std::to_string(album.getOwnerId()) + ");";
-	execStatement(sql.c_str());
+	static const std::vector<std::string> insertPictures = buildBulkInserts(
+		"INSERT INTO Pictures(NAME, LOCATION, CREATION_TIME, ALBUM_ID) VALUES", "(?, ?, ?, ?)");
+	static const std::vector<std::string> insertTags = buildBulkInserts(
+		"INSERT INTO Tags(PICTURE_ID, USER_ID) VALUES", "(?, ?)");
+
+	// the album, its pictures and their tags are written together or not at all
+	WriteBatch batch(*this);
+	auto stmt = prepareStatement("INSERT INTO Albums(NAME, CREATION_TIME, USER_ID) VALUES (?, ?, ?);",
+		album.getName(), album.getCreationTime(), album.getOwnerId());
+	execPrepared(stmt);
+	const int albumId = (int)sqlite3_last_insert_rowid(_db);
+
+	// a multi-row insert into an AUTOINCREMENT table hands out consecutive ids, so the id of every
+	// picture follows from last_insert_rowid of its chunk
+	const std::list<Picture> pictures = album.getPictures();
+	std::vector<std::pair<int, int>> tags; // (picture id, user id)
+	auto picture = pictures.begin();
+	for (size_t remaining = pictures.size(); remaining > 0;)
+	{
+		const int step = bulkInsertStep(remaining);
+		const int rows = BULK_INSERT_STEPS[step];
+		stmt = getStatement(insertPictures[step].c_str());
+		auto first = picture;
+		for (int i = 0; i < rows; i++, ++picture)
+		{
+			bindParams(stmt, i * 4 + 1, picture->getName(), picture->getPath(), picture->getCreationTime(), albumId);
+		}
+		execPrepared(stmt);
+
+		int pictureId = (int)sqlite3_last_insert_rowid(_db) - rows + 1;
+		for (auto it = first; it != picture; ++it, pictureId++)
+		{
+			for (int userId : it->getUserTags())
+			{
+				tags.emplace_back(pictureId, userId);
+			}
+		}
+		remaining -= rows;
+	}
+
+	for (size_t done = 0; done < tags.size();)
+	{
+		const int step = bulkInsertStep(tags.size() - done);
+		const int rows = BULK_INSERT_STEPS[step];
+		stmt = getStatement(insertTags[step].c_str());
+		for (int i = 0; i < rows; i++, done++)
+		{
+			bindParams(stmt, i * 2 + 1, tags[done].first, tags[done].second);
+		}
+		execPrepared(stmt);
+	}
+
+	batch.commit();
 }
 
 void DatabaseAccess::deleteAlbum(const std::string& albumName, int userId)
 {
-	const auto& sql = "DELETE FROM Albums WHERE USER_ID=" + std::to_string(userId) +
-		" AND NAME=\"" + albumName + "\";";
-	execStatement(sql.c_str());
+	auto stmt = prepareStatement("DELETE FROM Albums WHERE USER_ID=? AND NAME=?;", userId, albumName);
+	execPrepared(stmt);
 }
 
 bool DatabaseAccess::doesAlbumExists(const std::string& albumName, int userId)
 {
-	const auto& sql = "SELECT COUNT(1) FROM Albums WHERE NAME=\"" + albumName + "\" AND USER_ID=" + std::to_string(userId) + ';';
-	return countQuery(sql.c_str()) > 0;
+	auto stmt = prepareStatement("SELECT COUNT(1) FROM Albums WHERE NAME=? AND USER_ID=?;", albumName, userId);
+	return countQuery(stmt) > 0;
 }
 
 Album DatabaseAccess::openAlbum(const std::string& albumName)
 {
-	// const auto& sql = "SELECT NAME, CREATION_DATE, USER_ID FROM Albums WHERE NAME=\"" + albumName + "\";";
-	const auto& sql = "SELECT a.NAME ANAME, a.CREATION_DATE ACD, a.USER_ID AUID, p.NAME PNAME, LOCATION PLOC, p.CREATION_DATE PCD, p.ALBUM_ID PAID, t.USER_ID TUID FROM Albums a "\
-		"LEFT JOIN Pictures p ON ALBUM_ID = a.ID LEFT JOIN Tags t ON PICTURE_ID = p.ID "\
-		"WHERE ANAME=\"" + albumName + "\";";
-	Album album;
-	execQuery(sql.c_str(), singleAlbumDBCallback, &album);
+	int albumId = -1;
+	auto stmt = prepareStatement("SELECT ID FROM Albums WHERE NAME=? LIMIT 1;", albumName);
+	forEachRow(stmt, [&](sqlite3_stmt* row) { albumId = column<int>(row, 0); });
+	return albumId == -1 ? Album() : openAlbum(albumId);
+}
+
+Album DatabaseAccess::openAlbum(int albumId)
+{
+	std::optional<Album> album = readAlbum(prepareStatement("SELECT NAME, CREATION_TIME, USER_ID, ID FROM Albums WHERE ID=?;", albumId));
+	return album ? *album : Album();
+}
+
+std::optional<Album> DatabaseAccess::findAlbum(const std::string& albumName, int ownerId)
+{
+	return readAlbum(prepareStatement("SELECT NAME, CREATION_TIME, USER_ID, ID FROM Albums WHERE NAME=? AND USER_ID=? LIMIT 1;",
+		albumName, ownerId));
+}
+
+std::optional<Album> DatabaseAccess::readAlbum(sqlite3_stmt* stmt)
+{
+	// the album, its pictures and their tags are read as three separate streams and stitched
+	// together by picture id, instead of one album x pictures x tags join with a row per tag
+	std::optional<Album> album;
+	forEachRow(stmt, [&](sqlite3_stmt* row) { album = readRow<Album>(row); });
+	if (!album)
+	{
+		return album;
+	}
+	const int albumId = album->getId();
+
+	std::vector<Picture> pictures;
+	std::unordered_map<int, size_t> pictureIndex; // picture id -> position in pictures
+	stmt = prepareStatement("SELECT ID, NAME, LOCATION, CREATION_TIME FROM Pictures WHERE ALBUM_ID=? ORDER BY ID;", albumId);
+	forEachRow(stmt, [&](sqlite3_stmt* row) {
+		pictures.push_back(readRow<Picture>(row));
+		pictureIndex.emplace(pictures.back().getId(), pictures.size() - 1);
+	});
+
+	stmt = prepareStatement("SELECT t.PICTURE_ID, t.USER_ID FROM Pictures p JOIN Tags t ON t.PICTURE_ID=p.ID WHERE p.ALBUM_ID=?;", albumId);
+	forEachRow(stmt, [&](sqlite3_stmt* row) {
+		auto it = pictureIndex.find(column<int>(row, 0));
+		if (it != pictureIndex.end())
+		{
+			pictures[it->second].tagUser(column<int>(row, 1));
+		}
+	});
+
+	for (const auto& picture : pictures)
+	{
+		album->addPicture(picture);
+	}
 	return album;
 }
 
+int DatabaseAccess::findAlbumId(const std::string& albumName, int userId)
+{
+	int albumId = -1;
+	auto stmt = prepareStatement("SELECT ID FROM Albums WHERE NAME=? AND USER_ID=? LIMIT 1;", albumName, userId);
+	forEachRow(stmt, [&](sqlite3_stmt* row) { albumId = column<int>(row, 0); });
+	return albumId;
+}
+
 void DatabaseAccess::closeAlbum(Album& pAlbum)
 {
 }
@@ -309,105 +866,163 @@ void DatabaseAccess::printAlbums()
 {
 	std::cout << "Album list:" << std::endl;
 	std::cout << "-----------" << std::endl;
-	for (const Album& album : getAlbums()) {
+	forEachAlbum([](const Album& album) {
 		std::cout << std::setw(5) << "* " << album;
-	}
+	});
 }
 
 void DatabaseAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
 {
-	const auto& sql = "INSERT INTO Pictures(NAME, LOCATION, CREATION_DATE, ALBUM_ID) SELECT \"" + picture.getName()
-		+ "\", \"" + picture.getPath() + "\", \"" + picture.getCreationDate()
-		+ "\", ID FROM Albums WHERE NAME=\"" + albumName + "\" LIMIT 1;";
-	execStatement(sql.c_str());
+	auto stmt = prepareStatement("INSERT INTO Pictures(NAME, LOCATION, CREATION_TIME, ALBUM_ID) SELECT ?, ?, ?, ID FROM Albums WHERE NAME=? LIMIT 1;",
+		picture.getName(), picture.getPath(), picture.getCreationTime(), albumName);
+	execPrepared(stmt);
 }
 
 void DatabaseAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
 {
-	const auto& sql = "DELETE FROM Pictures WHERE ID IN (SELECT p.ID from Pictures p JOIN Albums a\
- ON p.ALBUM_ID=a.ID WHERE p.NAME=\"" + pictureName + "\" AND a.NAME=\"" + albumName + "\");";
-	execStatement(sql.c_str());
+	auto stmt = prepareStatement("DELETE FROM Pictures WHERE ID IN (SELECT p.ID from Pictures p JOIN Albums a\
+ ON p.ALBUM_ID=a.ID WHERE p.NAME=? AND a.NAME=?);", pictureName, albumName);
+	execPrepared(stmt);
 }
 
 void DatabaseAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
-	const auto& sql = "INSERT INTO Tags(PICTURE_ID, USER_ID) SELECT Pictures.ID, " + std::to_string(userId)
-		+ " FROM Pictures JOIN Albums ON Pictures.ALBUM_ID=Albums.ID WHERE Pictures.NAME = \"" + pictureName
-		+ "\" AND Albums.NAME=\"" + albumName + "\";";
-	execStatement(sql.c_str());
+	auto stmt = prepareStatement("INSERT INTO Tags(PICTURE_ID, USER_ID) SELECT Pictures.ID, ?"\
+		" FROM Pictures JOIN Albums ON Pictures.ALBUM_ID=Albums.ID WHERE Pictures.NAME = ? AND Albums.NAME=?;",
+		userId, pictureName, albumName);
+	execPrepared(stmt);
 }
 
 void DatabaseAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
-	const auto& sql = "DELETE FROM Tags WHERE USER_ID=" + std::to_string(userId)
-		+ " AND PICTURE_ID IN (SELECT p.ID FROM Pictures p JOIN Albums a ON ALBUM_ID=a.ID WHERE p.NAME=\"" 
-		+ pictureName + "\" AND a.NAME=\"" + albumName + "\");";
-	execStatement(sql.c_str());
+	auto stmt = prepareStatement("DELETE FROM Tags WHERE USER_ID=?"\
+		" AND PICTURE_ID IN (SELECT p.ID FROM Pictures p JOIN Albums a ON ALBUM_ID=a.ID WHERE p.NAME=? AND a.NAME=?);",
+		userId, pictureName, albumName);
+	execPrepared(stmt);
+}
+
+void DatabaseAccess::addPictureToAlbum(int albumId, Picture& picture)
+{
+	auto stmt = prepareStatement("INSERT INTO Pictures(NAME, LOCATION, CREATION_TIME, ALBUM_ID) VALUES (?, ?, ?, ?);",
+		picture.getName(), picture.getPath(), picture.getCreationTime(), albumId);
+	execPrepared(stmt);
+	picture.setId((int)sqlite3_last_insert_rowid(_db));
+}
+
+void DatabaseAccess::removePicture(int pictureId)
+{
+	auto stmt = prepareStatement("DELETE FROM Pictures WHERE ID=?;", pictureId);
+	execPrepared(stmt);
+}
+
+void DatabaseAccess::tagUser(int pictureId, int userId)
+{
+	auto stmt = prepareStatement("INSERT INTO Tags(PICTURE_ID, USER_ID) VALUES (?, ?);", pictureId, userId);
+	execPrepared(stmt);
+}
+
+void DatabaseAccess::untagUser(int pictureId, int userId)
+{
+	auto stmt = prepareStatement("DELETE FROM Tags WHERE PICTURE_ID=? AND USER_ID=?;", pictureId, userId);
+	execPrepared(stmt);
+}
+
+void DatabaseAccess::tagUserInAlbum(int albumId, int userId)
+{
+	auto stmt = prepareStatement("INSERT INTO Tags(PICTURE_ID, USER_ID) SELECT p.ID, ?1 FROM Pictures p WHERE p.ALBUM_ID=?2"\
+		" AND NOT EXISTS (SELECT 1 FROM Tags t WHERE t.PICTURE_ID=p.ID AND t.USER_ID=?1);", userId, albumId);
+	execPrepared(stmt);
+}
+
+void DatabaseAccess::untagUserInAlbum(int albumId, int userId)
+{
+	auto stmt = prepareStatement("DELETE FROM Tags WHERE USER_ID=?1 AND PICTURE_ID IN (SELECT ID FROM Pictures WHERE ALBUM_ID=?2);",
+		userId, albumId);
+	execPrepared(stmt);
 }
 
 void DatabaseAccess::printUsers()
 {
-	auto sql = "SELECT * FROM Users;";
-	execQuery(sql, printUserDBCallback, nullptr);
+	auto stmt = prepareStatement("SELECT ID, NAME FROM Users;");
+	forEachRow(stmt, [](sqlite3_stmt* row) { std::cout << readRow<User>(row) << std::endl; });
 }
 
 void DatabaseAccess::createUser(User& user)
 {
-	const auto& sql = "INSERT INTO Users(NAME) VALUES (\"" + user.getName() + "\");"\
-		"SELECT last_insert_rowid();";
-	int lastId;
-	execQuery(sql.c_str(), singleIntDBCallback, &lastId);
-	user.setId(lastId);
+	auto stmt = prepareStatement("INSERT INTO Users(NAME) VALUES (?);", user.getName());
+	execPrepared(stmt);
+	user.setId((int)sqlite3_last_insert_rowid(_db));
 }
 
 void DatabaseAccess::deleteUser(const User& user)
 {
-	const auto& sql = "DELETE FROM Users WHERE ID=" + std::to_string(user.getId()) + ';';
-	execStatement(sql.c_str());
+	auto stmt = prepareStatement("DELETE FROM Users WHERE ID=?;", user.getId());
+	execPrepared(stmt);
 }
 
 bool DatabaseAccess::doesUserExists(int userId)
 {
-	const auto& sql = "SELECT COUNT(1) FROM Users WHERE ID=" + std::to_string(userId) + ';';
-	return countQuery(sql.c_str()) > 0;
+	auto stmt = prepareStatement("SELECT COUNT(1) FROM Users WHERE ID=?;", userId);
+	return countQuery(stmt) > 0;
 }
 
 User DatabaseAccess::getUser(int userId)
 {
-	const auto& sql = "SELECT NAME FROM Users WHERE ID=" + std::to_string(userId) + ';';
-	User user(userId, "");
-	execQuery(sql.c_str(), singleUserDBCallback, &user);
-	if (user.getName().empty())
+	std::optional<User> user = findUser(userId);
+	if (!user)
 	{
 		throw ItemNotFoundException("User", userId);
 	}
+	return *user;
+}
+
+std::optional<User> DatabaseAccess::findUser(int userId)
+{
+	std::optional<User> user;
+	auto stmt = prepareStatement("SELECT ID, NAME FROM Users WHERE ID=?;", userId);
+	forEachRow(stmt, [&](sqlite3_stmt* row) { user = readRow<User>(row); });
 	return user;
 }
 
 int DatabaseAccess::countAlbumsOwnedOfUser(const User& user)
 {
-	const auto& sql = "SELECT COUNT(1) FROM Albums WHERE USER_ID=" + std::to_string(user.getId()) + ';';
-	return countQuery(sql.c_str());
+	auto stmt = prepareStatement("SELECT COUNT(1) FROM Albums WHERE USER_ID=?;", user.getId());
+	return countQuery(stmt);
 }
 
 int DatabaseAccess::countAlbumsTaggedOfUser(const User& user)
 {
-	const auto& sql = "SELECT * FROM Albums a JOIN Pictures p ON a.ID=ALBUM_ID JOIN Tags t ON "\
-		"PICTURE_ID=p.ID WHERE t.USER_ID=" + std::to_string(user.getId()) + ';';
-	return countQuery(sql.c_str());
+	auto stmt = prepareStatement("SELECT COUNT(DISTINCT p.ALBUM_ID) FROM Tags t JOIN Pictures p ON p.ID=t.PICTURE_ID WHERE t.USER_ID=?;", user.getId());
+	return countQuery(stmt);
 }
 
 int DatabaseAccess::countTagsOfUser(const User& user)
 {
-	const auto& sql = "SELECT COUNT(1) FROM Tags WHERE USER_ID=" + std::to_string(user.getId()) + ';';
-	return countQuery(sql.c_str());
+	auto stmt = prepareStatement("SELECT COUNT(1) FROM Tags WHERE USER_ID=?;", user.getId());
+	return countQuery(stmt);
 }
 
 float DatabaseAccess::averageTagsPerAlbumOfUser(const User& user)
 {
-	const auto& sql = "SELECT AVG(C) FROM (SELECT COUNT(1) C FROM Albums a JOIN Pictures p ON a.ID=p.ALBUM_ID "\
-		"JOIN Tags t ON PICTURE_ID=p.ID WHERE t.USER_ID=" + std::to_string(user.getId()) + " GROUP BY a.ID);";
-	float avg;
-	execQuery(sql.c_str(), singleFloatDBCallback, &avg);
+	auto stmt = prepareStatement("SELECT AVG(C) FROM (SELECT COUNT(1) C FROM Albums a JOIN Pictures p ON a.ID=p.ALBUM_ID "\
+		"JOIN Tags t ON PICTURE_ID=p.ID WHERE t.USER_ID=? GROUP BY a.ID);", user.getId());
+	float avg = 0;
+	forEachRow(stmt, [&](sqlite3_stmt* row) { avg = column<float>(row, 0); });
 	return avg;
 }
+
+UserStatistics DatabaseAccess::getUserStatistics(const User& user)
+{
+	// a single statement reads from a single snapshot, so the numbers always agree with each other
+	auto stmt = prepareStatement("WITH tagged AS (SELECT p.ALBUM_ID, COUNT(1) C FROM Tags t JOIN Pictures p ON p.ID=t.PICTURE_ID "\
+		"WHERE t.USER_ID=?1 GROUP BY p.ALBUM_ID) "\
+		"SELECT (SELECT COUNT(1) FROM Albums WHERE USER_ID=?1), COUNT(1), IFNULL(SUM(C), 0), IFNULL(AVG(C), 0) FROM tagged;", user.getId());
+	UserStatistics stats;
+	forEachRow(stmt, [&](sqlite3_stmt* row) {
+		stats.albumsOwned = column<int>(row, 0);
+		stats.albumsTagged = column<int>(row, 1);
+		stats.tags = column<int>(row, 2);
+		stats.averageTagsPerAlbum = column<float>(row, 3);
+	});
+	return stats;
+}
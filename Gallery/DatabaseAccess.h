@@ -1,30 +1,80 @@
 #pragma once
+#include <map>
+#include <string>
+#include <unordered_map>
 #include "IDataAccess.h"
+#include "OnlineBackup.h"
+#include "QueryProfiler.h"
+#include "SQLException.h"
 #include "sqlite3.h"
 
+// connection settings applied by DatabaseAccess::open()
+struct DatabaseOptions
+{
+	bool walJournal{ true };                    // journal_mode=WAL - readers don't block on the writer
+	int synchronous{ 1 };                       // 0 - OFF, 1 - NORMAL, 2 - FULL, 3 - EXTRA
+	long long mmapSize{ 256LL * 1024 * 1024 };  // bytes of the file read through mmap, 0 disables it
+	int cacheSizeKb{ 64 * 1024 };               // page cache of the connection
+	int tempStore{ 2 };                         // 0 - DEFAULT, 1 - FILE, 2 - MEMORY
+	int busyTimeoutMs{ 5000 };                  // how long to wait for a lock held by another connection
+	bool profileQueries{ true };                // collect per statement latencies for printQueryProfile
+	const char* memoryDatabase{ nullptr };      // ":memory:" or "file::memory:?cache=shared" - work on a copy of the
+	                                            // file in RAM, loaded on open() and saved by saveSnapshot() and close()
+	int vacuumFreelistPages{ 1024 };            // unused pages before runMaintenance() gives them back to the file system
+	bool maintainOnClose{ false };              // runMaintenance(false) in close() - PRAGMA optimize, which may ANALYZE
+	                                            // tables, and an incremental_vacuum on every close. off, so short runs
+	                                            // and tests close fast, the maintenance command does it on demand
+};
+
 class DatabaseAccess : public IDataAccess
 {
 
 public:
 	DatabaseAccess();
 	DatabaseAccess(const char* DBFileName);
-	virtual ~DatabaseAccess() = default;
+	DatabaseAccess(const char* DBFileName, const DatabaseOptions& options);
+	DatabaseAccess(const DatabaseAccess&) = delete; // owns the connection and its prepared statements
+	DatabaseAccess& operator=(const DatabaseAccess&) = delete;
+	virtual ~DatabaseAccess();
 
 	// album related
-	const std::list<Album> getAlbums() override;
-	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	std::list<Album> getAlbums() override;
+	std::list<Album> getAlbumsOfUser(const User& user) override;
 	void createAlbum(const Album& album) override;
 	void deleteAlbum(const std::string& albumName, int userId) override;
 	bool doesAlbumExists(const std::string& albumName, int userId) override;
 	Album openAlbum(const std::string& albumName) override;
+	Album openAlbum(int albumId) override;
+	int findAlbumId(const std::string& albumName, int userId) override;
+	std::optional<Album> findAlbum(const std::string& albumName, int ownerId) override;
 	void closeAlbum(Album& pAlbum) override;
 	void printAlbums() override;
 
+	// streaming
+	void forEachAlbum(const std::function<void(const Album&)>& visit) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit) override;
+	void forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit) override;
+
+	// paging
+	std::list<Album> getAlbums(int afterId, int limit) override;
+	std::list<User> getUsers(int afterId, int limit) override;
+	std::list<Picture> getPicturesOfAlbum(int albumId, int afterId, int limit) override;
+
+	// creation time ranges
+	std::list<Picture> getPicturesCreatedBetween(long long from, long long to) override;
+	std::list<Picture> getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to) override;
+
 	// picture related
 	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
 	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
 	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
 	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void addPictureToAlbum(int albumId, Picture& picture) override;
+	void removePicture(int pictureId) override;
+	void tagUser(int pictureId, int userId) override;
+	void untagUser(int pictureId, int userId) override;
+	void tagUserInAlbum(int albumId, int userId) override;
+	void untagUserInAlbum(int albumId, int userId) override;
 
 	// user related
 	void printUsers() override;
@@ -32,39 +82,152 @@ public:
 	void deleteUser(const User& user) override;
 	bool doesUserExists(int userId) override;
 	User getUser(int userId) override;
+	std::optional<User> findUser(int userId) override;
 
 	// user statistics
 	int countAlbumsOwnedOfUser(const User& user) override;
 	int countAlbumsTaggedOfUser(const User& user) override;
 	int countTagsOfUser(const User& user) override;
 	float averageTagsPerAlbumOfUser(const User& user) override;
+	UserStatistics getUserStatistics(const User& user) override;
 
 	// queries
 	User getTopTaggedUser() override;
 	Picture getTopTaggedPicture() override;
+	std::list<User> getTopTaggedUsers(int count) override;
+	std::list<Picture> getTopTaggedPictures(int count) override;
 	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+	std::list<Picture> searchPictures(const std::string& query, int limit) override;
+
+	// write batches
+	void beginBatch() override;
+	void commitBatch() override;
+	void rollbackBatch() override;
+
+	// change detection
+	long long getDataVersion() override;
+
+	// diagnostics
+	void printQueryProfile(std::ostream& out) override;
+	// EXPLAIN QUERY PLAN of every statement prepared so far, mapped from its sql to the plan lines
+	std::map<std::string, std::list<std::string>> explainQueryPlans();
+
+	// backup
+	void startBackup(const std::string& path) override;
+	BackupProgress getBackupProgress() override;
+
+	// maintenance
+	MaintenanceReport runMaintenance(bool allowFullVacuum) override;
 
 	bool open() override;
 	void close() override;
 	void clear() override;
 
+	// writes an in memory database back to its file, does nothing when working on the file itself
+	void saveSnapshot();
+
 
 private:
 	void execStatement(const char* sqlStatement) const;
-	void execQuery(const char* sqlStatement, int(*callback)(void*, int, char**, char**), void* callbackData) const;
-	void createDatabase() const;
+	void applyOptions();
+	void migrateDatabase();
+	bool isInMemory() const;
+	void loadSnapshot();
+	void closeConnection();
+	static void copyDatabase(sqlite3* from, sqlite3* to);
 
-	int countQuery(const char* sql) const;
-	static int albumListDBCallback(void* albumList, int argc, char** argv, char** azColName);
-	static int singleAlbumDBCallback(void* outAlbum, int argc, char** argv, char** azColName);
-	static int singleUserDBCallback(void* outUser, int argc, char** argv, char** azColName);
-	static int singlePictureDBCallback(void* outPicture, int argc, char** argv, char** azColName);
-	static int singleFloatDBCallback(void* out, int argc, char** argv, char** azColName);
-	static int singleIntDBCallback(void* out, int argc, char** argv, char** azColName);
+	// prepared statements - compiled once per connection and reused with new bindings
+	sqlite3_stmt* getStatement(const char* sql);
+	void finalizeStatements();
+	template <typename... Params>
+	sqlite3_stmt* prepareStatement(const char* sql, const Params&... params);
+	static void bindParams(sqlite3_stmt* stmt, int index);
+	template <typename T, typename... Params>
+	static void bindParams(sqlite3_stmt* stmt, int index, const T& value, const Params&... params);
+	static void bindParam(sqlite3_stmt* stmt, int index, int value);
+	static void bindParam(sqlite3_stmt* stmt, int index, long long value);
+	static void bindParam(sqlite3_stmt* stmt, int index, const std::string& value);
+	void execPrepared(sqlite3_stmt* stmt) const;
 
-	static int printUserDBCallback(void*, int argc, char** argv, char** azColName);
-	static int pictureListDBCallback(void* pictureList, int argc, char** argv, char** azColName);
+	// row decoding - values are read natively by position, so every query selects
+	// the columns of a mapped type in the order its readRow specialization expects:
+	//   User    - ID, NAME
+	//   Album   - NAME, CREATION_TIME, USER_ID, ID
+	//   Picture - ID, NAME, LOCATION, CREATION_TIME
+	template <typename T>
+	static T column(sqlite3_stmt* stmt, int index);
+	template <typename T>
+	static T readRow(sqlite3_stmt* stmt, int firstColumn = 0);
+	template <typename Func>
+	void forEachRow(sqlite3_stmt* stmt, Func onRow) const;
+	template <typename T>
+	std::list<T> queryList(sqlite3_stmt* stmt) const;
+
+	int countQuery(sqlite3_stmt* stmt) const;
+	void readTags(std::list<Picture>& pictures);
+	std::optional<Album> readAlbum(sqlite3_stmt* stmt); // the first album the statement selects, with its pictures
+
+	// resets a statement when leaving scope so it doesn't hold a read lock between calls
+	struct StatementReset
+	{
+		sqlite3_stmt* stmt;
+		~StatementReset() { sqlite3_reset(stmt); }
+	};
 
 	const char* _dbFileName;
 	sqlite3* _db;
+	DatabaseOptions _options;
+	long long _dataVersion;
+	int _lastExternalVersion;  // PRAGMA data_version - commits of other connections
+	long long _lastLocalChanges; // sqlite3_total_changes64 - writes of this connection
+	std::unordered_map<std::string, sqlite3_stmt*> _statements;
+	QueryProfiler _profiler;
+	OnlineBackup _backup;
 };
+
+template <typename... Params>
+sqlite3_stmt* DatabaseAccess::prepareStatement(const char* sql, const Params&... params)
+{
+	sqlite3_stmt* stmt = getStatement(sql);
+	bindParams(stmt, 1, params...);
+	return stmt;
+}
+
+template <typename T, typename... Params>
+void DatabaseAccess::bindParams(sqlite3_stmt* stmt, int index, const T& value, const Params&... params)
+{
+	bindParam(stmt, index, value);
+	bindParams(stmt, index + 1, params...);
+}
+
+template <> int DatabaseAccess::column<int>(sqlite3_stmt* stmt, int index);
+template <> long long DatabaseAccess::column<long long>(sqlite3_stmt* stmt, int index);
+template <> float DatabaseAccess::column<float>(sqlite3_stmt* stmt, int index);
+template <> std::string DatabaseAccess::column<std::string>(sqlite3_stmt* stmt, int index);
+
+template <> User DatabaseAccess::readRow<User>(sqlite3_stmt* stmt, int firstColumn);
+template <> Album DatabaseAccess::readRow<Album>(sqlite3_stmt* stmt, int firstColumn);
+template <> Picture DatabaseAccess::readRow<Picture>(sqlite3_stmt* stmt, int firstColumn);
+
+template <typename Func>
+void DatabaseAccess::forEachRow(sqlite3_stmt* stmt, Func onRow) const
+{
+	StatementReset reset{ stmt };
+	int res;
+	while ((res = sqlite3_step(stmt)) == SQLITE_ROW)
+	{
+		onRow(stmt);
+	}
+	if (res != SQLITE_DONE)
+	{
+		throw SQLException(sqlite3_errmsg(_db));
+	}
+}
+
+template <typename T>
+std::list<T> DatabaseAccess::queryList(sqlite3_stmt* stmt) const
+{
+	std::list<T> ans;
+	forEachRow(stmt, [&](sqlite3_stmt* row) { ans.push_back(readRow<T>(row)); });
+	return ans;
+}
@@ -1,6 +1,9 @@
 #include <iostream>
+#include <optional>
 #include <string>
+#include "CachingDataAccess.h"
 #include "DatabaseAccess.h"
+#include "WriteBehindDataAccess.h"
 #include "AlbumManager.h"
 
 #include "DataAccessTest.h"
@@ -41,13 +44,24 @@ void printWelcome()
 	std::cout << "Type " << HELP << " to a list of all supported commands" << std::endl;
 }
 
-int main(void)
+int main(int argc, char* argv[])
  {
+	// every command is committed by the time it returns. --write-behind writes tags in batches instead,
+	// the ones still held back (up to a second of them) are lost if the process dies before a flush
+	const bool writeBehind = argc > 1 && std::string(argv[1]) == "--write-behind";
+
 	// initialization data access
 	DatabaseAccess dataAccess;
+	std::optional<WriteBehindDataAccess> bufferedAccess;
+	if (writeBehind) {
+		bufferedAccess.emplace(dataAccess);
+		std::cout << "Write behind is on: tags are committed within a second, not when the command returns." << std::endl;
+	}
+	IDataAccess& storeAccess = bufferedAccess ? static_cast<IDataAccess&>(*bufferedAccess) : dataAccess;
+	CachingDataAccess cachedAccess(storeAccess); // all the writes go through it, so its caches stay exact
 
 	// initialize album manager
-	AlbumManager albumManager(dataAccess);
+	AlbumManager albumManager(cachedAccess);
 
 
 	std::string albumName;
@@ -63,5 +77,12 @@ int main(void)
 		catch (std::exception& e) {
 			std::cout << e.what() << std::endl;
 		}
+
+		// a held back tag fails after its own command returned, it is reported on its own
+		if (bufferedAccess) {
+			for (const auto& failed : bufferedAccess->takeFailedTags()) {
+				std::cout << "Failed to write the " << failed.write.describe() << ": " << failed.error << std::endl;
+			}
+		}
 	} while (true);
 }
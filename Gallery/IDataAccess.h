@@ -1,32 +1,85 @@
 #pragma once
+#include <functional>
 #include <list>
+#include <optional>
 #include "Album.h"
 #include "User.h"
 
+struct UserStatistics
+{
+	int albumsOwned{ 0 };
+	int albumsTagged{ 0 };  // albums with at least one picture the user is tagged in
+	int tags{ 0 };
+	float averageTagsPerAlbum{ 0 }; // over the tagged albums
+};
+
+struct BackupProgress
+{
+	bool running{ false };
+	int pagesCopied{ 0 };
+	int pageCount{ 0 };   // 0 until the first step read the size of the database
+	std::string path;
+	std::string error;    // empty when the last backup succeeded or none was started
+};
+
+struct MaintenanceReport
+{
+	int freelistPages{ 0 };       // unused pages in the file before the vacuum
+	bool vacuumed{ false };       // only when there were enough of them
+	long long bytesReclaimed{ 0 };
+};
+
 class IDataAccess
 {
 public:
 	virtual ~IDataAccess() = default;
 
 	// album related
-	virtual const std::list<Album> getAlbums() = 0;
-	virtual const std::list<Album> getAlbumsOfUser(const User& user) = 0;
+	virtual std::list<Album> getAlbums() = 0;
+	virtual std::list<Album> getAlbumsOfUser(const User& user) = 0;
 	virtual void createAlbum(const Album& album) = 0;
 	virtual void deleteAlbum(const std::string& albumName, int userId) = 0;
 	virtual bool doesAlbumExists(const std::string& albumName, int userId) = 0;
 	virtual Album openAlbum(const std::string& albumName) = 0;
+	virtual Album openAlbum(int albumId) = 0;
+	virtual int findAlbumId(const std::string& albumName, int userId) = 0; // -1 when the user has no such album
+	virtual std::optional<Album> findAlbum(const std::string& albumName, int ownerId) = 0; // opened, empty when there is none
 	virtual void closeAlbum(Album& pAlbum) = 0;
 	virtual void printAlbums() = 0;
 
+	// streaming - rows are handed to the visitor as they are read, without building a list.
+	// the visitor must not call back into the same query it is visiting
+	virtual void forEachAlbum(const std::function<void(const Album&)>& visit) = 0;
+	virtual void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit) = 0;
+	virtual void forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit) = 0;
+
+	// paging - up to limit rows with an id greater than afterId, in id order.
+	// pass the id of the last row of a page to get the next one, -1 starts from the beginning
+	virtual std::list<Album> getAlbums(int afterId, int limit) = 0;
+	virtual std::list<User> getUsers(int afterId, int limit) = 0;
+	virtual std::list<Picture> getPicturesOfAlbum(int albumId, int afterId, int limit) = 0;
+
+	// creation time ranges - from and to are seconds since the epoch and both included, oldest first
+	virtual std::list<Picture> getPicturesCreatedBetween(long long from, long long to) = 0;
+	virtual std::list<Picture> getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to) = 0;
+
     // picture related
 	virtual void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) = 0;
 	virtual void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) = 0;
 	virtual void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) = 0;
 	virtual void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) = 0;
+	// by the ids the open Album and its Pictures carry
+	virtual void addPictureToAlbum(int albumId, Picture& picture) = 0; // sets the id of the new picture
+	virtual void removePicture(int pictureId) = 0;
+	virtual void tagUser(int pictureId, int userId) = 0;
+	virtual void untagUser(int pictureId, int userId) = 0;
+	virtual void tagUserInAlbum(int albumId, int userId) = 0;   // in every picture the user isn't tagged in yet
+	virtual void untagUserInAlbum(int albumId, int userId) = 0;
 
 	// user related
 	virtual void printUsers() =0;
 	virtual User getUser(int userId) = 0;
+	virtual std::optional<User> findUser(int userId) = 0; // empty where getUser throws
 	virtual void createUser(User& user ) = 0;
 	virtual void deleteUser(const User& user) = 0;
 	virtual bool doesUserExists(int userId) = 0 ;
@@ -37,11 +90,37 @@ public:
 	virtual int countAlbumsTaggedOfUser(const User& user) = 0;
 	virtual int countTagsOfUser(const User& user) = 0;
 	virtual float averageTagsPerAlbumOfUser(const User& user) = 0;
+	virtual UserStatistics getUserStatistics(const User& user) = 0; // all of the above in one read
 
 	// queries
 	virtual User getTopTaggedUser() = 0;
 	virtual Picture getTopTaggedPicture() = 0;
+	virtual std::list<User> getTopTaggedUsers(int count) = 0;       // most tagged first
+	virtual std::list<Picture> getTopTaggedPictures(int count) = 0; // most tagged first
 	virtual std::list<Picture> getTaggedPicturesOfUser(const User& user) = 0;
+	// pictures whose name, path or album name has words starting with every word of the query
+	virtual std::list<Picture> searchPictures(const std::string& query, int limit) = 0;
+
+	// write batches - writes between begin and commit share a single transaction.
+	// batches may be nested, an inner rollback only undoes the inner batch
+	virtual void beginBatch() = 0;
+	virtual void commitBatch() = 0;
+	virtual void rollbackBatch() = 0;
+
+	// change detection - the value moves whenever stored data may have changed,
+	// so callers can skip reloading data they already hold
+	virtual long long getDataVersion() = 0;
+
+	// diagnostics
+	virtual void printQueryProfile(std::ostream& out) = 0;
+
+	// backup - copies the gallery to a file in the background while it stays in use
+	virtual void startBackup(const std::string& path) = 0;
+	virtual BackupProgress getBackupProgress() = 0;
+
+	// maintenance - refreshes the statistics of the query planner and gives unused space back.
+	// allowFullVacuum lets it rewrite the whole file where giving space back can't be done in place
+	virtual MaintenanceReport runMaintenance(bool allowFullVacuum) = 0;
 	
 	virtual bool open() = 0;
 	virtual void close() = 0;
@@ -0,0 +1,94 @@
+#pragma once
+#include <functional>
+#include <list>
+#include <map>
+#include <utility>
+
+// Map that drops the least recently used entries when their total weight would go over capacity.
+// Every entry weighs 1 unless a weigh function is given, so by default capacity counts entries.
+// Counts the hits and misses of find().
+template <typename Key, typename Value>
+class LruCache
+{
+public:
+	using Weigh = std::function<size_t(const Value&)>;
+
+	explicit LruCache(size_t capacity, Weigh weigh = [](const Value&) { return size_t(1); })
+		: m_capacity(capacity), m_weigh(std::move(weigh)) {}
+
+	// the cached value, or nullptr. the pointer is valid until the next change to the cache
+	const Value* find(const Key& key)
+	{
+		auto it = m_index.find(key);
+		if (it == m_index.end()) {
+			++m_misses;
+			return nullptr;
+		}
+		++m_hits;
+		m_entries.splice(m_entries.begin(), m_entries, it->second); // most recently used first
+		return &it->second->second;
+	}
+
+	void put(const Key& key, const Value& value)
+	{
+		erase(key);
+		const size_t weight = m_weigh(value);
+		if (weight > m_capacity) {
+			return; // would push out everything else and still not fit
+		}
+		while (m_weight + weight > m_capacity) {
+			erase(m_entries.back().first);
+		}
+		m_entries.emplace_front(key, value);
+		m_index[key] = m_entries.begin();
+		m_weight += weight;
+	}
+
+	void erase(const Key& key)
+	{
+		auto it = m_index.find(key);
+		if (it != m_index.end()) {
+			m_weight -= m_weigh(it->second->second);
+			m_entries.erase(it->second);
+			m_index.erase(it);
+		}
+	}
+
+	template <typename Predicate>
+	void eraseIf(Predicate shouldErase)
+	{
+		for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+			if (shouldErase(it->first, it->second)) {
+				m_weight -= m_weigh(it->second);
+				m_index.erase(it->first);
+				it = m_entries.erase(it);
+			}
+			else {
+				++it;
+			}
+		}
+	}
+
+	void clear()
+	{
+		m_entries.clear();
+		m_index.clear();
+		m_weight = 0;
+	}
+
+	size_t size() const { return m_entries.size(); }
+	size_t weight() const { return m_weight; }
+	long long getHits() const { return m_hits; }
+	long long getMisses() const { return m_misses; }
+
+private:
+	using Entries = std::list<std::pair<Key, Value>>;
+
+	size_t m_capacity;
+	Weigh m_weigh;
+	size_t m_weight{ 0 };
+	Entries m_entries; // most recently used first
+	std::map<Key, typename Entries::iterator> m_index;
+	long long m_hits{ 0 };
+	long long m_misses{ 0 };
+};
@@ -1,8 +1,10 @@
 ﻿#include <map>
 #include <algorithm>
+#include <iterator>
 
 #include "ItemNotFoundException.h"
 #include "MemoryAccess.h"
+#include "SearchTokens.h"
 
 
 
@@ -28,7 +30,7 @@ bool MemoryAccess::open()
 		User user(i, name.str());
 		createUser(user);
 
-		m_albums.push_back(createDummyAlbum(user));
+		createAlbum(createDummyAlbum(user));
 	}
 
 	return true;
@@ -36,8 +38,110 @@ bool MemoryAccess::open()
 
 void MemoryAccess::clear()
 {
+	saveUsersForUndo();
+	for (const auto& album : m_albums) {
+		saveForUndo(album);
+	}
 	m_users.clear();
 	m_albums.clear();
+	rebuildTagRankings();
+	rebuildSearchIndex();
+	++m_dataVersion;
+}
+
+void MemoryAccess::beginBatch()
+{
+	m_batchUndo.emplace_back();
+}
+
+void MemoryAccess::commitBatch()
+{
+	if (m_batchUndo.empty()) {
+		throw MyException("There is no open batch to commit.");
+	}
+	BatchUndo committed = std::move(m_batchUndo.back());
+	m_batchUndo.pop_back();
+	if (m_batchUndo.empty()) {
+		return;
+	}
+
+	// the outer batch now owns these writes, where it saved something itself its older copy wins
+	BatchUndo& outer = m_batchUndo.back();
+	for (auto& entry : committed.albums) {
+		outer.albums.emplace(entry.first, std::move(entry.second));
+	}
+	if (!outer.users) {
+		outer.users = std::move(committed.users);
+	}
+}
+
+void MemoryAccess::rollbackBatch()
+{
+	if (m_batchUndo.empty()) {
+		throw MyException("There is no open batch to roll back.");
+	}
+	BatchUndo undo = std::move(m_batchUndo.back());
+	m_batchUndo.pop_back();
+
+	for (auto& entry : undo.albums) {
+		m_albums.remove_if([&](const Album& album) { return album.getId() == entry.first; });
+		if (entry.second) {
+			auto position = std::find_if(m_albums.begin(), m_albums.end(), [&](const Album& album) { return album.getId() > entry.first; });
+			m_albums.insert(position, std::move(*entry.second));
+		}
+	}
+	if (undo.users) {
+		m_users = std::move(*undo.users);
+	}
+	rebuildTagRankings();
+	rebuildSearchIndex();
+	++m_dataVersion;
+}
+
+void MemoryAccess::saveForUndo(const Album& album)
+{
+	if (!m_batchUndo.empty()) {
+		m_batchUndo.back().albums.emplace(album.getId(), album); // a no-op once the batch has its copy
+	}
+}
+
+void MemoryAccess::saveCreatedForUndo(int albumId)
+{
+	if (!m_batchUndo.empty()) {
+		m_batchUndo.back().albums.emplace(albumId, std::nullopt);
+	}
+}
+
+void MemoryAccess::saveUsersForUndo()
+{
+	if (!m_batchUndo.empty() && !m_batchUndo.back().users) {
+		m_batchUndo.back().users = m_users;
+	}
+}
+
+long long MemoryAccess::getDataVersion()
+{
+	return m_dataVersion;
+}
+
+void MemoryAccess::printQueryProfile(std::ostream& out)
+{
+	out << "There are no queries to profile in memory access." << std::endl;
+}
+
+void MemoryAccess::startBackup(const std::string& )
+{
+	throw MyException("Memory access has no file to back up\n");
+}
+
+BackupProgress MemoryAccess::getBackupProgress()
+{
+	return BackupProgress();
+}
+
+MaintenanceReport MemoryAccess::runMaintenance(bool )
+{
+	return MaintenanceReport(); // nothing is stored, so there is nothing to keep up
 }
 
 auto MemoryAccess::getAlbumIfExists(const std::string & albumName)
@@ -51,6 +155,26 @@ auto MemoryAccess::getAlbumIfExists(const std::string & albumName)
 
 }
 
+auto MemoryAccess::getAlbumIfExists(int albumId)
+{
+	auto result = std::find_if(std::begin(m_albums), std::end(m_albums), [&](auto& album) { return album.getId() == albumId; });
+
+	if (result == std::end(m_albums)) {
+		throw ItemNotFoundException("Album", albumId);
+	}
+	return result;
+}
+
+auto MemoryAccess::getAlbumOfPicture(int pictureId)
+{
+	// m_pictureAlbums is kept with the search index, so the picture's album is one lookup away
+	auto albumId = m_pictureAlbums.find(pictureId);
+	if (albumId == m_pictureAlbums.end()) {
+		throw ItemNotFoundException("Picture", pictureId);
+	}
+	return getAlbumIfExists(albumId->second);
+}
+
 Album MemoryAccess::createDummyAlbum(const User& user)
 {
 	std::stringstream name("Album_" +std::to_string(user.getId()));
@@ -69,6 +193,85 @@ Album MemoryAccess::createDummyAlbum(const User& user)
 	return album;
 }
 
+// moves key by delta in a (counts, ranking) leaderboard pair, keys that drop to 0 leave both
+template <typename Key>
+static void changeRanking(std::map<Key, int>& counts, std::set<std::pair<int, Key>>& ranking, const Key& key, int delta)
+{
+	int& count = counts[key];
+	ranking.erase({ count, key });
+	count += delta;
+	if (count > 0) {
+		ranking.insert({ count, key });
+	}
+	else {
+		counts.erase(key);
+	}
+}
+
+void MemoryAccess::changeTagCount(int pictureId, int userId, int delta)
+{
+	changeRanking(m_userTagCounts, m_userRanking, userId, delta);
+	changeRanking(m_pictureTagCounts, m_pictureRanking, pictureId, delta);
+}
+
+void MemoryAccess::changeTagCounts(const Picture& picture, int delta)
+{
+	for (int userId : picture.getUserTags()) {
+		changeTagCount(picture.getId(), userId, delta);
+	}
+}
+
+void MemoryAccess::rebuildTagRankings()
+{
+	m_userTagCounts.clear();
+	m_userRanking.clear();
+	m_pictureTagCounts.clear();
+	m_pictureRanking.clear();
+	for (const auto& album : m_albums) {
+		for (const auto& picture : album.getPictures()) {
+			changeTagCounts(picture, 1);
+		}
+	}
+}
+
+void MemoryAccess::indexPicture(const Album& album, const Picture& picture, int delta)
+{
+	std::vector<std::string> words = splitSearchTokens(picture.getName());
+	for (const auto& text : { picture.getPath(), album.getName() }) {
+		const auto textWords = splitSearchTokens(text);
+		words.insert(words.end(), textWords.begin(), textWords.end());
+	}
+
+	for (const auto& word : words) {
+		if (delta > 0) {
+			m_searchIndex[word].insert(picture.getId());
+		}
+		else {
+			auto it = m_searchIndex.find(word);
+			if (it != m_searchIndex.end() && it->second.erase(picture.getId()) > 0 && it->second.empty()) {
+				m_searchIndex.erase(it);
+			}
+		}
+	}
+	if (delta > 0) {
+		m_pictureAlbums[picture.getId()] = album.getId();
+	}
+	else {
+		m_pictureAlbums.erase(picture.getId());
+	}
+}
+
+void MemoryAccess::rebuildSearchIndex()
+{
+	m_searchIndex.clear();
+	m_pictureAlbums.clear();
+	for (const auto& album : m_albums) {
+		for (const auto& picture : album.getPictures()) {
+			indexPicture(album, picture, 1);
+		}
+	}
+}
+
 void MemoryAccess::cleanUserData(const User& user)
 {
 	for (auto albumIt = m_albums.begin(); albumIt != m_albums.end(); ++albumIt) // have to use this method cause the iterator needs to be changed mid iteration
@@ -81,32 +284,134 @@ void MemoryAccess::cleanUserData(const User& user)
 	}
 }
 
-const std::list<Album> MemoryAccess::getAlbums() 
+std::list<Album> MemoryAccess::getAlbums() 
 {
 	return m_albums;
 }
 
-const std::list<Album> MemoryAccess::getAlbumsOfUser(const User& user) 
+std::list<Album> MemoryAccess::getAlbumsOfUser(const User& user) 
 {	
 	std::list<Album> albumsOfUser;
+	forEachAlbumOfUser(user, [&](const Album& album) { albumsOfUser.push_back(album); });
+	return albumsOfUser;
+}
+
+std::list<Album> MemoryAccess::getAlbums(int afterId, int limit)
+{
+	std::list<Album> page;
+	auto albumIt = std::find_if(m_albums.begin(), m_albums.end(), [&](const Album& album) { return album.getId() > afterId; });
+	for (; albumIt != m_albums.end() && (int)page.size() < limit; ++albumIt) {
+		page.push_back(*albumIt);
+	}
+	return page;
+}
+
+// users and pictures keep the ids they were created with, so they aren't stored in id order
+template <typename T>
+static std::list<T> pageById(const std::list<T>& items, int afterId, int limit)
+{
+	std::vector<const T*> matches;
+	for (const auto& item : items) {
+		if (item.getId() > afterId) {
+			matches.push_back(&item);
+		}
+	}
+	auto pageEnd = matches.begin() + std::min<size_t>(limit, matches.size());
+	std::partial_sort(matches.begin(), pageEnd, matches.end(),
+		[](const T* first, const T* second) { return first->getId() < second->getId(); });
+
+	std::list<T> page;
+	for (auto it = matches.begin(); it != pageEnd; ++it) {
+		page.push_back(**it);
+	}
+	return page;
+}
+
+std::list<User> MemoryAccess::getUsers(int afterId, int limit)
+{
+	return pageById(m_users, afterId, limit);
+}
+
+std::list<Picture> MemoryAccess::getPicturesOfAlbum(int albumId, int afterId, int limit)
+{
+	auto result = std::find_if(m_albums.begin(), m_albums.end(), [&](const Album& album) { return album.getId() == albumId; });
+	if (result == m_albums.end()) {
+		return std::list<Picture>(); // no album, no pictures - like the Pictures table
+	}
+	return pageById(result->getPictures(), afterId, limit);
+}
+
+// the pictures of the albums between from and to, oldest first
+static std::list<Picture> picturesCreatedBetween(const std::list<Album>& albums, long long from, long long to)
+{
+	std::list<Picture> pictures;
+	for (const auto& album : albums) {
+		for (const auto& picture : album.getPictures()) {
+			if (picture.getCreationTime() >= from && picture.getCreationTime() <= to) {
+				pictures.push_back(picture);
+			}
+		}
+	}
+	pictures.sort([](const Picture& first, const Picture& second) { return first.getCreationTime() < second.getCreationTime(); });
+	return pictures;
+}
+
+std::list<Picture> MemoryAccess::getPicturesCreatedBetween(long long from, long long to)
+{
+	return picturesCreatedBetween(m_albums, from, to);
+}
+
+std::list<Picture> MemoryAccess::getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to)
+{
+	auto result = std::find_if(m_albums.begin(), m_albums.end(), [&](const Album& album) { return album.getId() == albumId; });
+	if (result == m_albums.end()) {
+		return std::list<Picture>();
+	}
+	return picturesCreatedBetween({ *result }, from, to);
+}
+
+void MemoryAccess::forEachAlbum(const std::function<void(const Album&)>& visit)
+{
+	for (const auto& album: m_albums) {
+		visit(album);
+	}
+}
+
+void MemoryAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit)
+{
 	for (const auto& album: m_albums) {
 		if (album.getOwnerId() == user.getId()) {
-			albumsOfUser.push_back(album);
+			visit(album);
 		}
 	}
-	return albumsOfUser;
 }
 
 void MemoryAccess::createAlbum(const Album& album)
 {
-	m_albums.push_back(album);
+	// the pictures get ids of the gallery instead of the ones the caller picked
+	m_albums.emplace_back(album.getOwnerId(), album.getName(), album.getCreationTime());
+	m_albums.back().setId(m_nextAlbumId++);
+	saveCreatedForUndo(m_albums.back().getId());
+	for (auto picture : album.getPictures()) {
+		picture.setId(m_nextPictureId++);
+		m_albums.back().addPicture(picture);
+		changeTagCounts(picture, 1);
+		indexPicture(m_albums.back(), picture, 1);
+	}
+	++m_dataVersion;
 }
 
 void MemoryAccess::deleteAlbum(const std::string& albumName, int userId)
 {
 	for (auto iter = m_albums.begin(); iter != m_albums.end(); iter++) {
 		if ( iter->getName() == albumName && iter->getOwnerId() == userId ) {
+			saveForUndo(*iter);
+			for (const auto& picture : iter->getPictures()) {
+				changeTagCounts(picture, -1);
+				indexPicture(*iter, picture, -1);
+			}
 			iter = m_albums.erase(iter);
+			++m_dataVersion;
 			return;
 		}
 	}
@@ -133,32 +438,153 @@ Album MemoryAccess::openAlbum(const std::string& albumName)
 	throw MyException("No album with name " + albumName + " exists");
 }
 
+Album MemoryAccess::openAlbum(int albumId)
+{
+	for (const auto& album: m_albums) {
+		if (album.getId() == albumId) {
+			return album;
+		}
+	}
+	return Album(); // an empty album on a miss, like the database
+}
+
+std::optional<Album> MemoryAccess::findAlbum(const std::string& albumName, int ownerId)
+{
+	for (const auto& album: m_albums) {
+		if (album.getName() == albumName && album.getOwnerId() == ownerId) {
+			return album;
+		}
+	}
+	return std::nullopt;
+}
+
+int MemoryAccess::findAlbumId(const std::string& albumName, int userId)
+{
+	for (const auto& album: m_albums) {
+		if (album.getName() == albumName && album.getOwnerId() == userId) {
+			return album.getId();
+		}
+	}
+	return -1;
+}
+
 void MemoryAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture) 
 {
 	auto result = getAlbumIfExists(albumName);
 
-	(*result).addPicture(picture);
+	saveForUndo(*result);
+	Picture added = picture;
+	added.setId(m_nextPictureId++);
+	(*result).addPicture(added);
+	changeTagCounts(added, 1);
+	indexPicture(*result, added, 1);
+	++m_dataVersion;
 }
 
 void MemoryAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) 
 {
 	auto result = getAlbumIfExists(albumName);
-
-	(*result).removePicture(pictureName);
+	removePictureFrom(*result, (*result).getPicture(pictureName));
 }
 
 void MemoryAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
 	auto result = getAlbumIfExists(albumName);
-
-	(*result).tagUserInPicture(userId, pictureName);
+	tagUserIn(*result, (*result).getPicture(pictureName), userId);
 }
 
 void MemoryAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
 {
 	auto result = getAlbumIfExists(albumName);
+	untagUserIn(*result, (*result).getPicture(pictureName), userId);
+}
+
+void MemoryAccess::addPictureToAlbum(int albumId, Picture& picture)
+{
+	auto result = getAlbumIfExists(albumId);
+
+	saveForUndo(*result);
+	picture.setId(m_nextPictureId++);
+	(*result).addPicture(picture);
+	changeTagCounts(picture, 1);
+	indexPicture(*result, picture, 1);
+	++m_dataVersion;
+}
+
+// the id operations work on the album that holds the picture, album names are only unique per owner
+void MemoryAccess::removePicture(int pictureId)
+{
+	auto result = getAlbumOfPicture(pictureId);
+	removePictureFrom(*result, (*result).getPicture(pictureId));
+}
+
+void MemoryAccess::tagUser(int pictureId, int userId)
+{
+	auto result = getAlbumOfPicture(pictureId);
+	tagUserIn(*result, (*result).getPicture(pictureId), userId);
+}
+
+void MemoryAccess::untagUser(int pictureId, int userId)
+{
+	auto result = getAlbumOfPicture(pictureId);
+	untagUserIn(*result, (*result).getPicture(pictureId), userId);
+}
+
+void MemoryAccess::removePictureFrom(Album& album, const Picture& picture)
+{
+	saveForUndo(album);
+	album.removePicture(picture.getName());
+	changeTagCounts(picture, -1);
+	indexPicture(album, picture, -1);
+	++m_dataVersion;
+}
+
+void MemoryAccess::tagUserIn(Album& album, const Picture& picture, int userId)
+{
+	saveForUndo(album);
+	if (!picture.isUserTagged(userId)) {
+		changeTagCount(picture.getId(), userId, 1);
+	}
+	album.tagUserInPicture(userId, picture.getName());
+	++m_dataVersion;
+}
+
+void MemoryAccess::untagUserIn(Album& album, const Picture& picture, int userId)
+{
+	saveForUndo(album);
+	if (picture.isUserTagged(userId)) {
+		changeTagCount(picture.getId(), userId, -1);
+	}
+	album.untagUserInPicture(userId, picture.getName());
+	++m_dataVersion;
+}
+
+void MemoryAccess::tagUserInAlbum(int albumId, int userId)
+{
+	auto result = getAlbumIfExists(albumId);
+
+	saveForUndo(*result);
+	for (const auto& picture : (*result).getPictures()) {
+		if (!picture.isUserTagged(userId)) {
+			changeTagCount(picture.getId(), userId, 1);
+		}
+	}
+	(*result).tagUserInAlbum(userId);
+	++m_dataVersion;
+}
+
+void MemoryAccess::untagUserInAlbum(int albumId, int userId)
+{
+	auto result = getAlbumIfExists(albumId);
 
-	(*result).untagUserInPicture(userId, pictureName);
+	saveForUndo(*result);
+	for (const auto& picture : (*result).getPictures()) {
+		if (picture.isUserTagged(userId)) {
+			changeTagCount(picture.getId(), userId, -1);
+		}
+	}
+	(*result).untagUserInAlbum(userId);
+	++m_dataVersion;
 }
 
 void MemoryAccess::closeAlbum(Album& ) 
@@ -186,18 +612,38 @@ User MemoryAccess::getUser(int userId) {
 	throw ItemNotFoundException("User", userId);
 }
 
+std::optional<User> MemoryAccess::findUser(int userId)
+{
+	for (const auto& user : m_users) {
+		if (user.getId() == userId) {
+			return user;
+		}
+	}
+	return std::nullopt;
+}
+
 void MemoryAccess::createUser(User& user)
 {
+	saveUsersForUndo();
 	m_users.push_back(user);
+	++m_dataVersion;
 }
 
 void MemoryAccess::deleteUser(const User& user)
 {
 	if (doesUserExists(user.getId())) {
+		// removes the user's albums and untags them everywhere else, so every album is saved
+		saveUsersForUndo();
+		for (const auto& album : m_albums) {
+			saveForUndo(album);
+		}
 		cleanUserData(user);
 		for (auto iter = m_users.begin(); iter != m_users.end(); ++iter) {
 			if (*iter == user) {
 				iter = m_users.erase(iter);
+				rebuildTagRankings();
+				rebuildSearchIndex();
+				++m_dataVersion;
 				return;
 			}
 		}
@@ -268,91 +714,125 @@ int MemoryAccess::countTagsOfUser(const User& user)
 
 float MemoryAccess::averageTagsPerAlbumOfUser(const User& user) 
 {
-	int albumsTaggedCount = countAlbumsTaggedOfUser(user);
-
-	if ( 0 == albumsTaggedCount ) {
-		return 0;
-	}
-
-	return static_cast<float>(countTagsOfUser(user)) / albumsTaggedCount;
+	return getUserStatistics(user).averageTagsPerAlbum;
 }
 
-User MemoryAccess::getTopTaggedUser()
+UserStatistics MemoryAccess::getUserStatistics(const User& user)
 {
-	std::map<int, int> userTagsCountMap;
+	UserStatistics stats;
 
-	auto albumsIter = m_albums.begin();
 	for (const auto& album: m_albums) {
+		if (album.getOwnerId() == user.getId()) {
+			++stats.albumsOwned;
+		}
+
+		int albumTags = 0;
 		for (const auto& picture: album.getPictures()) {
-			
-			const std::set<int>& userTags = picture.getUserTags();
-			for (const auto& user: userTags ) {
-				//As map creates default constructed values, 
-				//users which we haven't yet encountered will start from 0
-				userTagsCountMap[user]++;
+			if (picture.isUserTagged(user)) {
+				++albumTags;
 			}
 		}
-	}
-
-	if (userTagsCountMap.size() == 0) {
-		throw MyException("There isn't any tagged user.");
-	}
-
-	int topTaggedUser = -1;
-	int currentMax = -1;
-	for (auto entry: userTagsCountMap) {
-		if (entry.second < currentMax) {
-			continue;
+		if (albumTags > 0) {
+			++stats.albumsTagged;
+			stats.tags += albumTags;
 		}
+	}
 
-		topTaggedUser = entry.first;
-		currentMax = entry.second;
+	if (stats.albumsTagged > 0) {
+		stats.averageTagsPerAlbum = static_cast<float>(stats.tags) / stats.albumsTagged;
 	}
+	return stats;
+}
 
-	if ( -1 == topTaggedUser ) {
-		throw MyException("Failed to find most tagged user");
+User MemoryAccess::getTopTaggedUser()
+{
+	auto top = getTopTaggedUsers(1);
+	if (top.empty()) {
+		throw MyException("There isn't any tagged user.");
 	}
 
-	return getUser(topTaggedUser);
+	return top.front();
 }
 
 Picture MemoryAccess::getTopTaggedPicture()
 {
-	int currentMax = -1;
-	std::unique_ptr<Picture> mostTaggedPic = nullptr;
-	for (const auto& album: m_albums) {
-		for (const Picture& picture: album.getPictures()) {
-			int tagsCount = picture.getTagsCount();
-			if (tagsCount == 0) {
-				continue;
-			}
+	auto top = getTopTaggedPictures(1);
+	if (top.empty()) {
+		throw MyException("There isn't any tagged picture.");
+	}
 
-			if (tagsCount <= currentMax) {
-				continue;
-			}
+	return top.front();
+}
 
-			mostTaggedPic = std::make_unique<Picture>(picture);
-			currentMax = tagsCount;
-		}
+std::list<User> MemoryAccess::getTopTaggedUsers(int count)
+{
+	std::list<User> users;
+	for (auto it = m_userRanking.rbegin(); it != m_userRanking.rend() && (int)users.size() < count; ++it) {
+		users.push_back(getUser(it->second));
 	}
-	if ( nullptr == mostTaggedPic ) {
-		throw MyException("There isn't any tagged picture.");
+
+	return users;
+}
+
+std::list<Picture> MemoryAccess::getTopTaggedPictures(int count)
+{
+	std::list<Picture> pictures;
+	for (auto it = m_pictureRanking.rbegin(); it != m_pictureRanking.rend() && (int)pictures.size() < count; ++it) {
+		const int pictureId = it->second;
+		pictures.push_back(getAlbumIfExists(m_pictureAlbums.at(pictureId))->getPicture(pictureId));
 	}
 
-	return *mostTaggedPic;	
+	return pictures;
 }
 
 std::list<Picture> MemoryAccess::getTaggedPicturesOfUser(const User& user)
 {
 	std::list<Picture> pictures;
+	forEachTaggedPictureOfUser(user, [&](const Picture& picture) { pictures.push_back(picture); });
+
+	return pictures;
+}
+
+std::list<Picture> MemoryAccess::searchPictures(const std::string& query, int limit)
+{
+	const auto words = splitSearchTokens(query);
+	std::set<int> matches;
+	for (size_t i = 0; i < words.size(); ++i) {
+		// the ids of every indexed word that starts with this query word
+		std::set<int> wordMatches;
+		for (auto it = m_searchIndex.lower_bound(words[i]);
+			it != m_searchIndex.end() && it->first.compare(0, words[i].size(), words[i]) == 0; ++it) {
+			wordMatches.insert(it->second.begin(), it->second.end());
+		}
+
+		if (i == 0) {
+			matches = std::move(wordMatches);
+		}
+		else {
+			std::set<int> both;
+			std::set_intersection(matches.begin(), matches.end(), wordMatches.begin(), wordMatches.end(),
+				std::inserter(both, both.end()));
+			matches = std::move(both);
+		}
+	}
+
+	std::list<Picture> pictures;
+	for (int pictureId : matches) {
+		if ((int)pictures.size() >= limit) {
+			break;
+		}
+		pictures.push_back(getAlbumIfExists(m_pictureAlbums.at(pictureId))->getPicture(pictureId));
+	}
+	return pictures;
+}
 
+void MemoryAccess::forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit)
+{
 	for (const auto& album: m_albums) {
 		for (const auto& picture: album.getPictures()) {
 			if (picture.isUserTagged(user)) {
-				pictures.push_back(picture);
+				visit(picture);
 			}
 		}
 	}
-
-	return pictures;
 }
@@ -1,5 +1,9 @@
 ﻿#pragma once
 #include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <vector>
 #include "Album.h"
 #include "User.h"
 #include "IDataAccess.h"
@@ -12,20 +16,43 @@ public:
 	virtual ~MemoryAccess() = default;
 
 	// album related
-	const std::list<Album> getAlbums() override;
-	const std::list<Album> getAlbumsOfUser(const User& user) override;
+	std::list<Album> getAlbums() override;
+	std::list<Album> getAlbumsOfUser(const User& user) override;
 	void createAlbum(const Album& album) override;
 	void deleteAlbum(const std::string& albumName, int userId) override;
 	bool doesAlbumExists(const std::string& albumName, int userId) override;
 	Album openAlbum(const std::string& albumName) override;
+	Album openAlbum(int albumId) override;
+	int findAlbumId(const std::string& albumName, int userId) override;
+	std::optional<Album> findAlbum(const std::string& albumName, int ownerId) override;
 	void closeAlbum(Album &pAlbum) override;
 	void printAlbums() override;
 
+	// streaming
+	void forEachAlbum(const std::function<void(const Album&)>& visit) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit) override;
+	void forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit) override;
+
+	// paging
+	std::list<Album> getAlbums(int afterId, int limit) override;
+	std::list<User> getUsers(int afterId, int limit) override;
+	std::list<Picture> getPicturesOfAlbum(int albumId, int afterId, int limit) override;
+
+	// creation time ranges
+	std::list<Picture> getPicturesCreatedBetween(long long from, long long to) override;
+	std::list<Picture> getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to) override;
+
 	// picture related
 	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
 	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
 	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
 	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void addPictureToAlbum(int albumId, Picture& picture) override;
+	void removePicture(int pictureId) override;
+	void tagUser(int pictureId, int userId) override;
+	void untagUser(int pictureId, int userId) override;
+	void tagUserInAlbum(int albumId, int userId) override;
+	void untagUserInAlbum(int albumId, int userId) override;
 
 	// user related
 	void printUsers() override;
@@ -33,17 +60,40 @@ public:
 	void deleteUser(const User& user) override;
 	bool doesUserExists(int userId) override;
 	User getUser(int userId) override;
+	std::optional<User> findUser(int userId) override;
 
 	// user statistics
 	int countAlbumsOwnedOfUser(const User& user) override;
     int countAlbumsTaggedOfUser(const User& user) override;
 	int countTagsOfUser(const User& user) override;
 	float averageTagsPerAlbumOfUser(const User& user) override;
+	UserStatistics getUserStatistics(const User& user) override;
 
 	// queries
 	User getTopTaggedUser() override;
 	Picture getTopTaggedPicture() override;
+	std::list<User> getTopTaggedUsers(int count) override;
+	std::list<Picture> getTopTaggedPictures(int count) override;
 	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+	std::list<Picture> searchPictures(const std::string& query, int limit) override;
+
+	// write batches
+	void beginBatch() override;
+	void commitBatch() override;
+	void rollbackBatch() override;
+
+	// change detection
+	long long getDataVersion() override;
+
+	// diagnostics
+	void printQueryProfile(std::ostream& out) override;
+
+	// backup
+	void startBackup(const std::string& path) override;
+	BackupProgress getBackupProgress() override;
+
+	// maintenance
+	MaintenanceReport runMaintenance(bool allowFullVacuum) override;
 
 	bool open() override;
 	void close() override {};
@@ -53,8 +103,45 @@ private:
 	std::list<Album> m_albums;
 	std::list<User> m_users;
 
+	// undo log, one per open batch. only what the batch writes is saved, the first time it writes it
+	struct BatchUndo {
+		std::map<int, std::optional<Album>> albums; // album id -> the album as the batch found it, empty if the batch created it
+		std::optional<std::list<User>> users;
+	};
+	std::vector<BatchUndo> m_batchUndo;
+	long long m_dataVersion{ 0 }; // bumped by every mutation
+	int m_nextAlbumId{ 1 };       // albums get increasing ids, so m_albums stays in id order
+	int m_nextPictureId{ 1 };     // pictures are numbered across all albums, like the Pictures table
+
+	// tag leaderboards, updated on every tag change. pictures are keyed by id, album and picture
+	// names are only unique per owner and per album
+	std::map<int, int> m_userTagCounts;
+	std::set<std::pair<int, int>> m_userRanking;    // (tags, user id) - most tagged last
+	std::map<int, int> m_pictureTagCounts;
+	std::set<std::pair<int, int>> m_pictureRanking; // (tags, picture id) - most tagged last
+
+	// search index - ordered, so the words a query word is a prefix of are one range
+	std::map<std::string, std::set<int>> m_searchIndex; // word -> ids of the pictures it is in
+	std::map<int, int> m_pictureAlbums;                 // picture id -> id of its album
+
 	auto getAlbumIfExists(const std::string& albumName);
+	auto getAlbumIfExists(int albumId);
+	auto getAlbumOfPicture(int pictureId);
+
+	// the writes behind the name and the id operations, on the album that holds the picture
+	void removePictureFrom(Album& album, const Picture& picture);
+	void tagUserIn(Album& album, const Picture& picture, int userId);
+	void untagUserIn(Album& album, const Picture& picture, int userId);
+
+	void saveForUndo(const Album& album);
+	void saveCreatedForUndo(int albumId);
+	void saveUsersForUndo();
 
 	Album createDummyAlbum(const User& user);
 	void cleanUserData(const User& user);
+	void changeTagCount(int pictureId, int userId, int delta);
+	void changeTagCounts(const Picture& picture, int delta);
+	void rebuildTagRankings();
+	void indexPicture(const Album& album, const Picture& picture, int delta);
+	void rebuildSearchIndex();
 };
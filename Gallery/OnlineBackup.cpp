@@ -0,0 +1,115 @@
+#include "OnlineBackup.h"
+#include "MyException.h"
+
+OnlineBackup::~OnlineBackup()
+{
+	cancel();
+}
+
+void OnlineBackup::start(sqlite3* source, const std::string& path)
+{
+	if (_running)
+	{
+		throw MyException("A backup is already running\n");
+	}
+	join(); // the thread of the last backup is done but not joined yet
+
+	_cancelled = false;
+	_pagesCopied = 0;
+	_pageCount = 0;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_path = path;
+		_error.clear();
+	}
+	_running = true;
+
+	if (sqlite3_threadsafe() == 1)
+	{
+		_thread = std::thread(&OnlineBackup::run, this, source, path);
+	}
+	else
+	{
+		// the connection can't be shared with another thread, copy it in place instead
+		run(source, path);
+	}
+}
+
+void OnlineBackup::cancel()
+{
+	_cancelled = true;
+	join();
+}
+
+BackupProgress OnlineBackup::getProgress() const
+{
+	BackupProgress progress;
+	progress.running = _running;
+	progress.pagesCopied = _pagesCopied;
+	progress.pageCount = _pageCount;
+	std::lock_guard<std::mutex> lock(_mutex);
+	progress.path = _path;
+	progress.error = _error;
+	return progress;
+}
+
+void OnlineBackup::run(sqlite3* source, const std::string& path)
+{
+	sqlite3* file = nullptr;
+	if (sqlite3_open(path.c_str(), &file) != SQLITE_OK)
+	{
+		finish(sqlite3_errmsg(file));
+		sqlite3_close(file);
+		return;
+	}
+
+	sqlite3_backup* backup = sqlite3_backup_init(file, "main", source, "main");
+	if (backup == nullptr)
+	{
+		finish(sqlite3_errmsg(file));
+		sqlite3_close(file);
+		return;
+	}
+
+	int res = SQLITE_OK;
+	while (!_cancelled)
+	{
+		res = sqlite3_backup_step(backup, PAGES_PER_STEP);
+		_pageCount = sqlite3_backup_pagecount(backup);
+		_pagesCopied = _pageCount - sqlite3_backup_remaining(backup);
+		if (res != SQLITE_OK && res != SQLITE_BUSY && res != SQLITE_LOCKED)
+		{
+			break;
+		}
+		sqlite3_sleep(STEP_PAUSE_MS); // busy and locked are retried after the pause as well
+	}
+
+	// finishing an unfinished backup rolls the file back, it's either complete or untouched
+	sqlite3_backup_finish(backup);
+	sqlite3_close(file);
+	if (_cancelled && res != SQLITE_DONE)
+	{
+		finish("Backup was cancelled");
+	}
+	else
+	{
+		finish(res == SQLITE_DONE ? "" : sqlite3_errstr(res));
+	}
+}
+
+void OnlineBackup::finish(const std::string& error)
+{
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_error = error;
+	}
+	_running = false;
+}
+
+void OnlineBackup::join()
+{
+	if (_thread.joinable())
+	{
+		_thread.join();
+	}
+}
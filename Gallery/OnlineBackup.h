@@ -0,0 +1,42 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "IDataAccess.h"
+#include "sqlite3.h"
+
+// Copies a live connection to a file with sqlite3_backup_step on a background thread.
+// Each step copies a few pages and then pauses, so the source is only locked for short moments
+// and the writes of its connection go on in between. Writes made through the source connection
+// are carried into the copy, writes of other connections restart it.
+class OnlineBackup
+{
+public:
+	static const int PAGES_PER_STEP = 256;
+	static const int STEP_PAUSE_MS = 10;
+
+	OnlineBackup() = default;
+	OnlineBackup(const OnlineBackup&) = delete;
+	OnlineBackup& operator=(const OnlineBackup&) = delete;
+	~OnlineBackup();
+
+	// the source connection has to outlive the backup, call cancel() before closing it
+	void start(sqlite3* source, const std::string& path);
+	void cancel();
+	BackupProgress getProgress() const;
+
+private:
+	void run(sqlite3* source, const std::string& path);
+	void finish(const std::string& error);
+	void join();
+
+	std::thread _thread;
+	std::atomic<bool> _running{ false };
+	std::atomic<bool> _cancelled{ false };
+	std::atomic<int> _pagesCopied{ 0 };
+	std::atomic<int> _pageCount{ 0 };
+	mutable std::mutex _mutex; // guards the strings
+	std::string _path;
+	std::string _error;
+};
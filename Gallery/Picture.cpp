@@ -4,13 +4,13 @@
 
 
 Picture::Picture(int id, const std::string& name): 
-	m_pictureId(id), m_name(name), m_pathOnDisk(""), m_creationDate("")
+	m_pictureId(id), m_name(name), m_pathOnDisk(""), m_creationTime(0)
 {
 	setCreationDateNow();
 }
 
-Picture::Picture(int id, const std::string& name, const std::string& pathOnDisk, const std::string& creationDate)
-	: m_pictureId(id), m_name(name), m_pathOnDisk(pathOnDisk), m_creationDate(creationDate)
+Picture::Picture(int id, const std::string& name, const std::string& pathOnDisk, long long creationTime)
+	: m_pictureId(id), m_name(name), m_pathOnDisk(pathOnDisk), m_creationTime(creationTime)
 {
 	// Left empty
 }
@@ -45,22 +45,27 @@ void Picture::setPath(const std::string& location)
 	m_pathOnDisk = location;
 }
 
-const std::string& Picture::getCreationDate() const
+long long Picture::getCreationTime() const
 {
-	return m_creationDate;
+	return m_creationTime;
 }
 
-void Picture::setCreationDate(const std::string& creationTime)
+void Picture::setCreationTime(long long creationTime)
 {
-	m_creationDate = creationTime;
+	m_creationTime = creationTime;
 }
 
-void Picture::setCreationDateNow()
+std::string Picture::getCreationDate() const
 {
-	time_t now = time(nullptr);
+	time_t creationTime = (time_t)m_creationTime;
 	std::stringstream oss;
-	oss << std::put_time(localtime(&now), "%d/%m/%Y %H:%M:%S");
-	m_creationDate = oss.str();
+	oss << std::put_time(localtime(&creationTime), "%d/%m/%Y %H:%M:%S");
+	return oss.str();
+}
+
+void Picture::setCreationDateNow()
+{
+	m_creationTime = time(nullptr);
 }
 
 bool Picture::isUserTagged(const User& user) const
@@ -114,7 +119,7 @@ bool Picture::operator==(const Picture& other) const
 
 std::ostream& operator<<(std::ostream& strOut, const Picture& pic) {
 	strOut << "Picture@" << pic.m_pictureId << ": ["
-		<< pic.m_name << ", " << pic.m_creationDate << ", " << pic.m_pathOnDisk <<
+		<< pic.m_name << ", " << pic.getCreationDate() << ", " << pic.m_pathOnDisk <<
 		"] " << pic.getTagsCount() << " users tagged : ";
 	
 	for (const auto user : pic.m_usersTags) {
@@ -9,7 +9,7 @@ class Picture
 {
 public:
 	Picture(int id, const std::string& name);
-	Picture(int id, const std::string& name, const std::string& pathOnDisk, const std::string& creationDate);
+	Picture(int id, const std::string& name, const std::string& pathOnDisk, long long creationTime);
 
 	int getId() const;
 	void setId(int id);
@@ -20,8 +20,9 @@ public:
 	const std::string& getPath() const;
 	void setPath(const std::string& location);
 
-	const std::string& getCreationDate() const;
-	void setCreationDate(const std::string& creationTime);
+	long long getCreationTime() const;
+	void setCreationTime(long long creationTime);
+	std::string getCreationDate() const; // the creation time formatted for display, in local time
 	void setCreationDateNow();
 
 	bool isUserTagged(const User& user) const;
@@ -41,6 +42,6 @@ private:
 	int m_pictureId;
 	std::string m_name;
 	std::string m_pathOnDisk;
-	std::string m_creationDate;
+	long long m_creationTime; // seconds since the epoch
 	std::set<int> m_usersTags;
 };
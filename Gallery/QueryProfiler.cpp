@@ -0,0 +1,108 @@
+#include "QueryProfiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <vector>
+
+void QueryProfiler::attach(sqlite3* db)
+{
+	sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, traceCallback, this);
+}
+
+void QueryProfiler::detach(sqlite3* db)
+{
+	sqlite3_trace_v2(db, 0, nullptr, nullptr);
+}
+
+void QueryProfiler::clear()
+{
+	_stats.clear();
+}
+
+int QueryProfiler::traceCallback(unsigned type, void* context, void* p, void* x)
+{
+	QueryProfiler* profiler = (QueryProfiler*)context;
+	sqlite3_stmt* stmt = (sqlite3_stmt*)p;
+	if (type == SQLITE_TRACE_PROFILE)
+	{
+		// read and reset, so a cached statement reports the steps of this run only
+		long long vmSteps = sqlite3_stmt_status(stmt, SQLITE_STMTSTATUS_VM_STEP, 1);
+		profiler->record(sqlite3_sql(stmt), (long long)*(sqlite3_uint64*)x, vmSteps);
+	}
+	return 0;
+}
+
+int QueryProfiler::bucketOf(long long ns)
+{
+	if (ns < SUB_BUCKETS)
+	{
+		return (int)std::max(ns, 0LL);
+	}
+	int log2 = 0;
+	while ((ns >> (log2 + 1)) != 0)
+	{
+		log2++;
+	}
+	// the two bits after the leading one pick the sub bucket
+	int sub = (int)((ns >> (log2 - 2)) & (SUB_BUCKETS - 1));
+	return std::min(log2 * SUB_BUCKETS + sub, BUCKETS - 1);
+}
+
+long long QueryProfiler::bucketUpperBound(int bucket)
+{
+	if (bucket < SUB_BUCKETS)
+	{
+		return bucket;
+	}
+	int log2 = bucket / SUB_BUCKETS;
+	int sub = bucket % SUB_BUCKETS;
+	return ((1LL << log2) | ((long long)sub << (log2 - 2))) + (1LL << (log2 - 2)) - 1;
+}
+
+void QueryProfiler::record(const char* sql, long long ns, long long vmSteps)
+{
+	QueryStats& stats = _stats[sql == nullptr ? "" : sql];
+	stats.calls++;
+	stats.vmSteps += vmSteps;
+	stats.totalNs += ns;
+	stats.maxNs = std::max(stats.maxNs, ns);
+	stats.histogram[bucketOf(ns)]++;
+}
+
+long long QueryProfiler::QueryStats::percentileNs(double percentile) const
+{
+	long long target = (long long)(calls * percentile / 100.0);
+	long long seen = 0;
+	for (int bucket = 0; bucket < BUCKETS; bucket++)
+	{
+		seen += histogram[bucket];
+		if (seen > target)
+		{
+			return std::min(bucketUpperBound(bucket), maxNs);
+		}
+	}
+	return maxNs;
+}
+
+void QueryProfiler::print(std::ostream& out) const
+{
+	// slowest in total first, that's where tuning pays off the most
+	std::vector<std::pair<const std::string*, const QueryStats*>> sorted;
+	for (const auto& entry : _stats)
+	{
+		sorted.emplace_back(&entry.first, &entry.second);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto& first, const auto& second) {
+		return first.second->totalNs > second.second->totalNs;
+	});
+
+	out << std::setw(10) << "calls" << std::setw(12) << "vm steps" << std::setw(12) << "total ms"
+		<< std::setw(10) << "avg us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << "  statement" << std::endl;
+	for (const auto& entry : sorted)
+	{
+		const QueryStats& stats = *entry.second;
+		out << std::setw(10) << stats.calls << std::setw(12) << stats.vmSteps
+			<< std::setw(12) << stats.totalNs / 1000000 << std::setw(10) << stats.totalNs / stats.calls / 1000
+			<< std::setw(10) << stats.percentileNs(99) / 1000 << std::setw(10) << stats.maxNs / 1000
+			<< "  " << *entry.first << std::endl;
+	}
+}
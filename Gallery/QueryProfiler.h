@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include "sqlite3.h"
+
+// Collects per statement call counts, virtual machine steps and latencies of a connection through
+// sqlite3_trace_v2. Only the end of every statement is traced - the steps are read from the
+// statement's own counters then, so profiling costs nothing per row.
+// Statements are grouped by their SQL text, which for prepared statements is the template with
+// the parameters still unbound.
+class QueryProfiler
+{
+public:
+	// latencies are kept in a log scale histogram, 4 buckets per power of two nanoseconds
+	static const int SUB_BUCKETS = 4;
+	static const int BUCKETS = 64 * SUB_BUCKETS;
+
+	struct QueryStats
+	{
+		long long calls{ 0 };
+		long long vmSteps{ 0 }; // sqlite3 opcodes run - the work done, whatever the number of rows
+		long long totalNs{ 0 };
+		long long maxNs{ 0 };
+		std::array<long long, BUCKETS> histogram{};
+
+		long long percentileNs(double percentile) const;
+	};
+
+	void attach(sqlite3* db);
+	void detach(sqlite3* db);
+	void clear();
+	void print(std::ostream& out) const;
+
+private:
+	static int traceCallback(unsigned type, void* context, void* p, void* x);
+	static int bucketOf(long long ns);
+	static long long bucketUpperBound(int bucket);
+	void record(const char* sql, long long ns, long long vmSteps);
+
+	std::unordered_map<std::string, QueryStats> _stats;
+};
@@ -0,0 +1,29 @@
+#include "SearchTokens.h"
+
+std::vector<std::string> splitSearchTokens(const std::string& text)
+{
+	std::vector<std::string> tokens;
+	std::string token;
+	for (char c : text)
+	{
+		const unsigned char byte = (unsigned char)c;
+		if (byte >= 0x80 || (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z'))
+		{
+			token += c;
+		}
+		else if (byte >= 'A' && byte <= 'Z')
+		{
+			token += (char)(byte - 'A' + 'a');
+		}
+		else if (!token.empty())
+		{
+			tokens.push_back(token);
+			token.clear();
+		}
+	}
+	if (!token.empty())
+	{
+		tokens.push_back(token);
+	}
+	return tokens;
+}
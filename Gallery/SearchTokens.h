@@ -0,0 +1,7 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// Splits text into the lower case words the picture search matches on. Anything that isn't an ascii
+// letter or digit separates words, other utf-8 bytes are kept inside them, like the FTS5 tokenizer does.
+std::vector<std::string> splitSearchTokens(const std::string& text);
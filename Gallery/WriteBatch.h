@@ -0,0 +1,37 @@
+#pragma once
+#include "IDataAccess.h"
+
+// Scoped write batch - rolls back unless commit() was called before it goes out of scope
+class WriteBatch
+{
+public:
+	WriteBatch(IDataAccess& dataAccess) : m_dataAccess(dataAccess), m_done(false)
+	{
+		m_dataAccess.beginBatch();
+	}
+
+	~WriteBatch()
+	{
+		if (!m_done) {
+			try {
+				m_dataAccess.rollbackBatch();
+			}
+			catch (...) {
+				// destructors must not throw, the batch is abandoned either way
+			}
+		}
+	}
+
+	WriteBatch(const WriteBatch&) = delete;
+	WriteBatch& operator=(const WriteBatch&) = delete;
+
+	void commit()
+	{
+		m_dataAccess.commitBatch();
+		m_done = true;
+	}
+
+private:
+	IDataAccess& m_dataAccess;
+	bool m_done;
+};
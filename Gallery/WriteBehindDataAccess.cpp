@@ -0,0 +1,531 @@
+#include "WriteBehindDataAccess.h"
+#include "MyException.h"
+#include "WriteBatch.h"
+
+WriteBehindDataAccess::WriteBehindDataAccess(IDataAccess& dataAccess, size_t maxPending, int durabilityWindowMs)
+	: m_dataAccess(dataAccess), m_maxPending(maxPending), m_durabilityWindow(durabilityWindowMs)
+{
+	if (m_durabilityWindow.count() > 0) {
+		m_flusher = std::thread(&WriteBehindDataAccess::run, this);
+	}
+}
+
+WriteBehindDataAccess::~WriteBehindDataAccess()
+{
+	{
+		auto guard = lock();
+		m_stopping = true;
+	}
+	m_wakeUp.notify_all();
+	if (m_flusher.joinable()) {
+		m_flusher.join();
+	}
+	try {
+		writePending();
+	}
+	catch (...) {
+		// destructors must not throw, the tags that could be written were
+	}
+}
+
+// ******************* Pending tags ******************* 
+bool WriteBehindDataAccess::PendingTag::isSamePicture(const PendingTag& other) const
+{
+	return userId == other.userId && pictureId == other.pictureId &&
+		albumName == other.albumName && pictureName == other.pictureName;
+}
+
+std::string WriteBehindDataAccess::PendingTag::describe() const
+{
+	const std::string picture = pictureId == -1 ? pictureName + " in album " + albumName : std::to_string(pictureId);
+	return std::string(tag ? "tag" : "untag") + " of user " + std::to_string(userId) + " in picture " + picture;
+}
+
+std::unique_lock<std::recursive_mutex> WriteBehindDataAccess::lock()
+{
+	return std::unique_lock<std::recursive_mutex>(m_mutex);
+}
+
+std::unique_lock<std::recursive_mutex> WriteBehindDataAccess::flushed()
+{
+	auto guard = lock();
+	writePending();
+	return guard;
+}
+
+std::list<WriteBehindDataAccess::FailedTag> WriteBehindDataAccess::takeFailedTags()
+{
+	auto guard = lock();
+	std::list<FailedTag> failed;
+	failed.swap(m_failedTags);
+	return failed;
+}
+
+void WriteBehindDataAccess::reportFailedTags()
+{
+	std::list<FailedTag> failed = takeFailedTags();
+	if (failed.empty()) {
+		return;
+	}
+	std::string message = std::to_string(failed.size()) + " held back tags failed to be written:";
+	for (const auto& tag : failed) {
+		message += "\n" + tag.write.describe() + " - " + tag.error;
+	}
+	throw MyException(message);
+}
+
+void WriteBehindDataAccess::buffer(const PendingTag& pending)
+{
+	auto guard = lock();
+	m_buffered++;
+	if (!pending.tag) {
+		// the untag removes every tag of the user in the picture, the ones still waiting included
+		size_t before = m_pending.size();
+		m_pending.remove_if([&](const PendingTag& other) { return other.isSamePicture(pending); });
+		m_coalesced += before - m_pending.size();
+	}
+	if (m_pending.empty()) {
+		m_oldestPending = std::chrono::steady_clock::now();
+		m_wakeUp.notify_all();
+	}
+	m_pending.push_back(pending);
+
+	if (m_durabilityWindow.count() <= 0) {
+		// written right away, so the only tag that can fail is this one
+		writePending();
+		reportFailedTags();
+	}
+	else if (m_pending.size() >= m_maxPending) {
+		writePending();
+	}
+}
+
+void WriteBehindDataAccess::writePending()
+{
+	if (m_pending.empty()) {
+		return;
+	}
+	std::list<PendingTag> pending;
+	pending.swap(m_pending); // a write that fails is not tried again by the next flush
+	m_flushes++;
+	const long long versionBefore = m_dataAccess.getDataVersion();
+
+	// one failed tag doesn't undo the others, each keeps its own error for the next report
+	std::list<FailedTag> failed;
+	try {
+		WriteBatch batch(m_dataAccess);
+		for (const auto& write : pending) {
+			try {
+				if (write.pictureId == -1 && write.tag) {
+					m_dataAccess.tagUserInPicture(write.albumName, write.pictureName, write.userId);
+				}
+				else if (write.pictureId == -1) {
+					m_dataAccess.untagUserInPicture(write.albumName, write.pictureName, write.userId);
+				}
+				else if (write.tag) {
+					m_dataAccess.tagUser(write.pictureId, write.userId);
+				}
+				else {
+					m_dataAccess.untagUser(write.pictureId, write.userId);
+				}
+			}
+			catch (const std::exception& e) {
+				failed.push_back({ write, e.what() });
+			}
+		}
+		batch.commit();
+	}
+	catch (const std::exception& e) {
+		// the batch didn't commit, so none of its writes did
+		failed.clear();
+		for (const auto& write : pending) {
+			failed.push_back({ write, e.what() });
+		}
+	}
+	m_failedTags.splice(m_failedTags.end(), failed);
+	m_flushedVersions += m_dataAccess.getDataVersion() - versionBefore;
+}
+
+void WriteBehindDataAccess::run()
+{
+	auto guard = lock();
+	while (!m_stopping) {
+		if (m_pending.empty()) {
+			m_wakeUp.wait(guard);
+		}
+		else if (std::chrono::steady_clock::now() < m_oldestPending + m_durabilityWindow) {
+			m_wakeUp.wait_until(guard, m_oldestPending + m_durabilityWindow);
+		}
+		else {
+			try {
+				writePending();
+			}
+			catch (const std::exception&) {
+				// only the version read can throw here, the tags are in m_failedTags
+			}
+		}
+	}
+}
+
+void WriteBehindDataAccess::flush()
+{
+	auto guard = flushed();
+	reportFailedTags();
+}
+
+// ******************* Album ******************* 
+std::list<Album> WriteBehindDataAccess::getAlbums()
+{
+	auto guard = flushed();
+	return m_dataAccess.getAlbums();
+}
+
+std::list<Album> WriteBehindDataAccess::getAlbumsOfUser(const User& user)
+{
+	auto guard = flushed();
+	return m_dataAccess.getAlbumsOfUser(user);
+}
+
+void WriteBehindDataAccess::createAlbum(const Album& album)
+{
+	auto guard = flushed();
+	m_dataAccess.createAlbum(album);
+}
+
+void WriteBehindDataAccess::deleteAlbum(const std::string& albumName, int userId)
+{
+	auto guard = flushed();
+	m_dataAccess.deleteAlbum(albumName, userId);
+}
+
+bool WriteBehindDataAccess::doesAlbumExists(const std::string& albumName, int userId)
+{
+	auto guard = lock();
+	return m_dataAccess.doesAlbumExists(albumName, userId);
+}
+
+Album WriteBehindDataAccess::openAlbum(const std::string& albumName)
+{
+	auto guard = flushed();
+	return m_dataAccess.openAlbum(albumName);
+}
+
+Album WriteBehindDataAccess::openAlbum(int albumId)
+{
+	auto guard = flushed();
+	return m_dataAccess.openAlbum(albumId);
+}
+
+std::optional<Album> WriteBehindDataAccess::findAlbum(const std::string& albumName, int ownerId)
+{
+	auto guard = flushed();
+	return m_dataAccess.findAlbum(albumName, ownerId);
+}
+
+int WriteBehindDataAccess::findAlbumId(const std::string& albumName, int userId)
+{
+	auto guard = lock();
+	return m_dataAccess.findAlbumId(albumName, userId);
+}
+
+void WriteBehindDataAccess::closeAlbum(Album& pAlbum)
+{
+	auto guard = lock();
+	m_dataAccess.closeAlbum(pAlbum);
+}
+
+void WriteBehindDataAccess::printAlbums()
+{
+	auto guard = flushed();
+	m_dataAccess.printAlbums();
+}
+
+void WriteBehindDataAccess::forEachAlbum(const std::function<void(const Album&)>& visit)
+{
+	auto guard = flushed();
+	m_dataAccess.forEachAlbum(visit);
+}
+
+void WriteBehindDataAccess::forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit)
+{
+	auto guard = flushed();
+	m_dataAccess.forEachAlbumOfUser(user, visit);
+}
+
+void WriteBehindDataAccess::forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit)
+{
+	auto guard = flushed();
+	m_dataAccess.forEachTaggedPictureOfUser(user, visit);
+}
+
+std::list<Album> WriteBehindDataAccess::getAlbums(int afterId, int limit)
+{
+	auto guard = flushed();
+	return m_dataAccess.getAlbums(afterId, limit);
+}
+
+std::list<User> WriteBehindDataAccess::getUsers(int afterId, int limit)
+{
+	auto guard = lock();
+	return m_dataAccess.getUsers(afterId, limit);
+}
+
+std::list<Picture> WriteBehindDataAccess::getPicturesOfAlbum(int albumId, int afterId, int limit)
+{
+	auto guard = flushed();
+	return m_dataAccess.getPicturesOfAlbum(albumId, afterId, limit);
+}
+
+std::list<Picture> WriteBehindDataAccess::getPicturesCreatedBetween(long long from, long long to)
+{
+	auto guard = flushed();
+	return m_dataAccess.getPicturesCreatedBetween(from, to);
+}
+
+std::list<Picture> WriteBehindDataAccess::getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to)
+{
+	auto guard = flushed();
+	return m_dataAccess.getPicturesOfAlbumCreatedBetween(albumId, from, to);
+}
+
+// ******************* Picture ******************* 
+void WriteBehindDataAccess::addPictureToAlbumByName(const std::string& albumName, const Picture& picture)
+{
+	auto guard = flushed();
+	m_dataAccess.addPictureToAlbumByName(albumName, picture);
+}
+
+void WriteBehindDataAccess::removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName)
+{
+	auto guard = flushed();
+	m_dataAccess.removePictureFromAlbumByName(albumName, pictureName);
+}
+
+void WriteBehindDataAccess::tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	buffer({ true, userId, -1, albumName, pictureName });
+}
+
+void WriteBehindDataAccess::untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId)
+{
+	buffer({ false, userId, -1, albumName, pictureName });
+}
+
+void WriteBehindDataAccess::addPictureToAlbum(int albumId, Picture& picture)
+{
+	auto guard = flushed();
+	m_dataAccess.addPictureToAlbum(albumId, picture);
+}
+
+void WriteBehindDataAccess::removePicture(int pictureId)
+{
+	auto guard = flushed();
+	m_dataAccess.removePicture(pictureId);
+}
+
+void WriteBehindDataAccess::tagUser(int pictureId, int userId)
+{
+	buffer({ true, userId, pictureId, "", "" });
+}
+
+void WriteBehindDataAccess::untagUser(int pictureId, int userId)
+{
+	buffer({ false, userId, pictureId, "", "" });
+}
+
+void WriteBehindDataAccess::tagUserInAlbum(int albumId, int userId)
+{
+	auto guard = flushed();
+	m_dataAccess.tagUserInAlbum(albumId, userId);
+}
+
+void WriteBehindDataAccess::untagUserInAlbum(int albumId, int userId)
+{
+	auto guard = flushed();
+	m_dataAccess.untagUserInAlbum(albumId, userId);
+}
+
+// ******************* User ******************* 
+void WriteBehindDataAccess::printUsers()
+{
+	auto guard = lock();
+	m_dataAccess.printUsers();
+}
+
+User WriteBehindDataAccess::getUser(int userId)
+{
+	auto guard = lock();
+	return m_dataAccess.getUser(userId);
+}
+
+std::optional<User> WriteBehindDataAccess::findUser(int userId)
+{
+	auto guard = lock();
+	return m_dataAccess.findUser(userId);
+}
+
+void WriteBehindDataAccess::createUser(User& user)
+{
+	auto guard = lock();
+	m_dataAccess.createUser(user);
+}
+
+void WriteBehindDataAccess::deleteUser(const User& user)
+{
+	auto guard = flushed();
+	m_dataAccess.deleteUser(user);
+}
+
+bool WriteBehindDataAccess::doesUserExists(int userId)
+{
+	auto guard = lock();
+	return m_dataAccess.doesUserExists(userId);
+}
+
+// ******************* Statistics & queries ******************* 
+int WriteBehindDataAccess::countAlbumsOwnedOfUser(const User& user)
+{
+	auto guard = lock();
+	return m_dataAccess.countAlbumsOwnedOfUser(user);
+}
+
+int WriteBehindDataAccess::countAlbumsTaggedOfUser(const User& user)
+{
+	auto guard = flushed();
+	return m_dataAccess.countAlbumsTaggedOfUser(user);
+}
+
+int WriteBehindDataAccess::countTagsOfUser(const User& user)
+{
+	auto guard = flushed();
+	return m_dataAccess.countTagsOfUser(user);
+}
+
+float WriteBehindDataAccess::averageTagsPerAlbumOfUser(const User& user)
+{
+	auto guard = flushed();
+	return m_dataAccess.averageTagsPerAlbumOfUser(user);
+}
+
+UserStatistics WriteBehindDataAccess::getUserStatistics(const User& user)
+{
+	auto guard = flushed();
+	return m_dataAccess.getUserStatistics(user);
+}
+
+User WriteBehindDataAccess::getTopTaggedUser()
+{
+	auto guard = flushed();
+	return m_dataAccess.getTopTaggedUser();
+}
+
+Picture WriteBehindDataAccess::getTopTaggedPicture()
+{
+	auto guard = flushed();
+	return m_dataAccess.getTopTaggedPicture();
+}
+
+std::list<User> WriteBehindDataAccess::getTopTaggedUsers(int count)
+{
+	auto guard = flushed();
+	return m_dataAccess.getTopTaggedUsers(count);
+}
+
+std::list<Picture> WriteBehindDataAccess::getTopTaggedPictures(int count)
+{
+	auto guard = flushed();
+	return m_dataAccess.getTopTaggedPictures(count);
+}
+
+std::list<Picture> WriteBehindDataAccess::getTaggedPicturesOfUser(const User& user)
+{
+	auto guard = flushed();
+	return m_dataAccess.getTaggedPicturesOfUser(user);
+}
+
+std::list<Picture> WriteBehindDataAccess::searchPictures(const std::string& query, int limit)
+{
+	auto guard = flushed();
+	return m_dataAccess.searchPictures(query, limit);
+}
+
+// ******************* Batches, diagnostics & lifetime ******************* 
+// the pending tags are written before a batch starts or ends, so they land where they were made
+
+void WriteBehindDataAccess::beginBatch()
+{
+	auto guard = flushed();
+	m_dataAccess.beginBatch();
+}
+
+void WriteBehindDataAccess::commitBatch()
+{
+	auto guard = flushed();
+	m_dataAccess.commitBatch();
+}
+
+void WriteBehindDataAccess::rollbackBatch()
+{
+	auto guard = lock();
+	try {
+		writePending();
+	}
+	catch (...) {
+		// the batch is undone either way, a rollback that throws would leave it open
+	}
+	m_dataAccess.rollbackBatch();
+}
+
+long long WriteBehindDataAccess::getDataVersion()
+{
+	// a tag moves the version once, when it is queued. writing it moves the wrapped version again,
+	// so what the flushes moved it by is taken back out. neither part ever goes back
+	auto guard = lock();
+	return m_dataAccess.getDataVersion() - m_flushedVersions + m_buffered;
+}
+
+void WriteBehindDataAccess::printQueryProfile(std::ostream& out)
+{
+	auto guard = lock();
+	out << "Write behind: " << m_buffered << " tags and untags, " << m_coalesced << " dropped by a later untag, "
+		<< m_flushes << " flushes, " << m_pending.size() << " pending" << std::endl << std::endl;
+	m_dataAccess.printQueryProfile(out);
+}
+
+void WriteBehindDataAccess::startBackup(const std::string& path)
+{
+	auto guard = flushed();
+	m_dataAccess.startBackup(path);
+}
+
+BackupProgress WriteBehindDataAccess::getBackupProgress()
+{
+	auto guard = lock();
+	return m_dataAccess.getBackupProgress();
+}
+
+MaintenanceReport WriteBehindDataAccess::runMaintenance(bool allowFullVacuum)
+{
+	auto guard = flushed();
+	return m_dataAccess.runMaintenance(allowFullVacuum);
+}
+
+bool WriteBehindDataAccess::open()
+{
+	auto guard = lock();
+	return m_dataAccess.open();
+}
+
+void WriteBehindDataAccess::close()
+{
+	auto guard = flushed();
+	m_dataAccess.close(); // even when a tag failed, the store and its threads are closed first
+	reportFailedTags();
+}
+
+void WriteBehindDataAccess::clear()
+{
+	auto guard = lock();
+	m_pending.clear();
+	m_dataAccess.clear();
+}
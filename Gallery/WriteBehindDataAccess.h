@@ -0,0 +1,162 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "IDataAccess.h"
+
+// Wraps another data access and holds back tagging and untagging of users in pictures, so a run
+// of them is written as one batch instead of a statement each. An untag drops the pending tags of
+// the same user in the same picture, since it removes them all anyway.
+// The pending writes are flushed when maxPending of them are waiting, when the oldest has waited
+// the durability window, before any other call that reads or writes pictures or tags, and on close().
+// A tag that fails to be written is kept with its error until takeFailedTags(), flush() or close() hands
+// it over - the other calls, the tags that flushed it included, never see it.
+// With a durability window a tag is only committed once it is flushed, the ones still pending are
+// lost if the process dies. All calls to the wrapped data access go through this one.
+class WriteBehindDataAccess : public IDataAccess
+{
+public:
+	static const size_t DEFAULT_MAX_PENDING = 64;
+	static const int DEFAULT_DURABILITY_WINDOW_MS = 1000; // 0 writes every tag right away
+
+	struct PendingTag
+	{
+		bool tag;               // false for an untag
+		int userId;
+		int pictureId;          // -1 when the picture is given by name
+		std::string albumName;
+		std::string pictureName;
+
+		bool isSamePicture(const PendingTag& other) const;
+		std::string describe() const;
+	};
+
+	struct FailedTag
+	{
+		PendingTag write;
+		std::string error;
+	};
+
+	explicit WriteBehindDataAccess(IDataAccess& dataAccess, size_t maxPending = DEFAULT_MAX_PENDING,
+		int durabilityWindowMs = DEFAULT_DURABILITY_WINDOW_MS);
+	WriteBehindDataAccess(const WriteBehindDataAccess&) = delete;
+	WriteBehindDataAccess& operator=(const WriteBehindDataAccess&) = delete;
+	virtual ~WriteBehindDataAccess();
+
+	// album related
+	std::list<Album> getAlbums() override;
+	std::list<Album> getAlbumsOfUser(const User& user) override;
+	void createAlbum(const Album& album) override;
+	void deleteAlbum(const std::string& albumName, int userId) override;
+	bool doesAlbumExists(const std::string& albumName, int userId) override;
+	Album openAlbum(const std::string& albumName) override;
+	Album openAlbum(int albumId) override;
+	int findAlbumId(const std::string& albumName, int userId) override;
+	std::optional<Album> findAlbum(const std::string& albumName, int ownerId) override;
+	void closeAlbum(Album& pAlbum) override;
+	void printAlbums() override;
+
+	// streaming
+	void forEachAlbum(const std::function<void(const Album&)>& visit) override;
+	void forEachAlbumOfUser(const User& user, const std::function<void(const Album&)>& visit) override;
+	void forEachTaggedPictureOfUser(const User& user, const std::function<void(const Picture&)>& visit) override;
+
+	// paging
+	std::list<Album> getAlbums(int afterId, int limit) override;
+	std::list<User> getUsers(int afterId, int limit) override;
+	std::list<Picture> getPicturesOfAlbum(int albumId, int afterId, int limit) override;
+
+	// creation time ranges
+	std::list<Picture> getPicturesCreatedBetween(long long from, long long to) override;
+	std::list<Picture> getPicturesOfAlbumCreatedBetween(int albumId, long long from, long long to) override;
+
+	// picture related
+	void addPictureToAlbumByName(const std::string& albumName, const Picture& picture) override;
+	void removePictureFromAlbumByName(const std::string& albumName, const std::string& pictureName) override;
+	void tagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void untagUserInPicture(const std::string& albumName, const std::string& pictureName, int userId) override;
+	void addPictureToAlbum(int albumId, Picture& picture) override;
+	void removePicture(int pictureId) override;
+	void tagUser(int pictureId, int userId) override;
+	void untagUser(int pictureId, int userId) override;
+	void tagUserInAlbum(int albumId, int userId) override;
+	void untagUserInAlbum(int albumId, int userId) override;
+
+	// user related
+	void printUsers() override;
+	User getUser(int userId) override;
+	std::optional<User> findUser(int userId) override;
+	void createUser(User& user) override;
+	void deleteUser(const User& user) override;
+	bool doesUserExists(int userId) override;
+
+	// user statistics
+	int countAlbumsOwnedOfUser(const User& user) override;
+	int countAlbumsTaggedOfUser(const User& user) override;
+	int countTagsOfUser(const User& user) override;
+	float averageTagsPerAlbumOfUser(const User& user) override;
+	UserStatistics getUserStatistics(const User& user) override;
+
+	// queries
+	User getTopTaggedUser() override;
+	Picture getTopTaggedPicture() override;
+	std::list<User> getTopTaggedUsers(int count) override;
+	std::list<Picture> getTopTaggedPictures(int count) override;
+	std::list<Picture> getTaggedPicturesOfUser(const User& user) override;
+	std::list<Picture> searchPictures(const std::string& query, int limit) override;
+
+	// write batches
+	void beginBatch() override;
+	void commitBatch() override;
+	void rollbackBatch() override;
+
+	// change detection
+	long long getDataVersion() override;
+
+	// diagnostics - the write behind counters come before the profile of the wrapped data access
+	void printQueryProfile(std::ostream& out) override;
+
+	// backup
+	void startBackup(const std::string& path) override;
+	BackupProgress getBackupProgress() override;
+
+	// maintenance
+	MaintenanceReport runMaintenance(bool allowFullVacuum) override;
+
+	// writes the pending tags now, and throws if any tag failed to be written since the last report
+	void flush();
+	// the tags that failed to be written since the last report, oldest first - reporting without a throw
+	std::list<FailedTag> takeFailedTags();
+
+	bool open() override;
+	void close() override;
+	void clear() override;
+
+private:
+	std::unique_lock<std::recursive_mutex> lock();
+	std::unique_lock<std::recursive_mutex> flushed(); // locked, with nothing pending
+	void buffer(const PendingTag& pending);
+	void writePending(); // a tag that fails goes to m_failedTags, the others are still written
+	void reportFailedTags();
+	void run();
+
+	IDataAccess& m_dataAccess;
+	const size_t m_maxPending;
+	const std::chrono::milliseconds m_durabilityWindow;
+
+	std::recursive_mutex m_mutex; // guards everything below and every call to the wrapped data access
+	std::condition_variable_any m_wakeUp;
+	std::list<PendingTag> m_pending;
+	std::chrono::steady_clock::time_point m_oldestPending;
+	std::list<FailedTag> m_failedTags; // the tags that failed since the last report
+	long long m_flushedVersions{ 0 }; // how far the flushes moved the wrapped version, already counted in m_buffered
+	bool m_stopping{ false };
+	std::thread m_flusher;
+
+	long long m_buffered{ 0 };
+	long long m_coalesced{ 0 };
+	long long m_flushes{ 0 };
+};